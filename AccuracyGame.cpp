@@ -36,7 +36,7 @@
 
 
 AccuracyGame::AccuracyGame() :  m_errorCode(RC_OK),
-                                m_offsetDeg(0.0)
+                                m_angleRaw(0)
 {
 
 }
@@ -56,7 +56,7 @@ uint8_t AccuracyGame::initialize(Safe* safe)
   stm_newState = STM_STATE_ACCURACY_GAME_INIT;
 
   m_safe = safe;
-  m_safe->setBarGraphResolution( BAR_GRAPH_RESOLUTION_DEG);
+  m_safe->setBarGraphResolution( BAR_GRAPH_RESOLUTION_RAW);
 	return m_errorCode;
 }
 
@@ -93,14 +93,10 @@ uint8_t AccuracyGame::run()
 			stm_newState = STM_STATE_ACCURACY_GAME_CHECK_VALUE;
 			stm_entryFlag = FALSE;
 			stm_exitFlag = TRUE;
+			// Get Offset, sample of this tick
+			m_safe->setNullPosition();
 		}
-		// Get Offset
-    m_safe->setNullPosition();
 
-#ifdef DEBUG
-		Serial.println("Offset");
-		Serial.println(m_offsetDeg);
-#endif
 
 		// Exit
 		if (stm_exitFlag == TRUE)
@@ -126,23 +122,23 @@ uint8_t AccuracyGame::run()
 			stm_exitFlag  = FALSE;
 		}
 
-    m_targetAngleDeg      = TARGET_ANGLE;
-    m_targetAngleDegKids  = TARGET_ANGLE_KIDS;
+    m_targetAngleRaw      = TARGET_ANGLE_RAW;
+    m_targetAngleKidsRaw  = TARGET_ANGLE_KIDS_RAW;
     
-    if (m_angleDeg > 200)
+    if (m_angleRaw > KIDS_LEVEL_THRESHOLD_RAW)
     {
-      m_safe->setBarGraphResolution( BAR_GRAPH_RESOLUTION_KIDS_DEG);
-      m_safe->getAndDisplayAngles(m_targetAngleDegKids, m_angleDeg);
+      m_safe->setBarGraphResolution( BAR_GRAPH_RESOLUTION_KIDS_RAW);
+      m_safe->getAndDisplayAngles(m_targetAngleKidsRaw, m_angleRaw);
     }
     else
     {
-      m_safe->setBarGraphResolution( BAR_GRAPH_RESOLUTION_DEG);
-      m_safe->getAndDisplayAngles(m_targetAngleDeg, m_angleDeg);
+      m_safe->setBarGraphResolution( BAR_GRAPH_RESOLUTION_RAW);
+      m_safe->getAndDisplayAngles(m_targetAngleRaw, m_angleRaw);
     }
 
 
 		// Within tolerance?
-		if ((m_angleDeg > (m_targetAngleDeg - ANGLE_HYSTERESYS_DEG)) && (m_angleDeg < (m_targetAngleDeg + ANGLE_HYSTERESYS_DEG)))
+		if (angleRawDistance(m_angleRaw, m_targetAngleRaw) < ANGLE_HYSTERESYS_RAW)
 		{
 			m_lastDebounceTime = millis(); // Reset timer
 			stm_newState = STM_STATE_ACCURACY_GAME_IN_TOLERANCE;
@@ -151,7 +147,7 @@ uint8_t AccuracyGame::run()
 		}
 
     // Within tolerance?
-    if ((m_angleDeg > (m_targetAngleDegKids - ANGLE_HYSTERESYS_DEG_KIDS)) && (m_angleDeg < (m_targetAngleDegKids + ANGLE_HYSTERESYS_DEG_KIDS)))
+    if (angleRawDistance(m_angleRaw, m_targetAngleKidsRaw) < ANGLE_HYSTERESYS_KIDS_RAW)
     {
       m_lastDebounceTime = millis(); // Reset timer
       stm_newState = STM_STATE_ACCURACY_GAME_IN_TOLERANCE_KIDS;
@@ -184,10 +180,10 @@ uint8_t AccuracyGame::run()
 			stm_exitFlag = FALSE;
 		}
 
-		m_safe->getAndDisplayAngles(m_targetAngleDeg, m_angleDeg);
+		m_safe->getAndDisplayAngles(m_targetAngleRaw, m_angleRaw);
 
 		// Within tolerance?
-		if ((m_angleDeg < (m_targetAngleDeg - ANGLE_HYSTERESYS_DEG)) || (m_angleDeg > (m_targetAngleDeg + ANGLE_HYSTERESYS_DEG)))
+		if (angleRawDistance(m_angleRaw, m_targetAngleRaw) > ANGLE_HYSTERESYS_RAW)
 		{
 			stm_newState = STM_STATE_ACCURACY_GAME_OVER;
 			stm_entryFlag = FALSE;
@@ -225,20 +221,19 @@ uint8_t AccuracyGame::run()
       stm_entryFlag = FALSE;
       stm_exitFlag = FALSE;
     }
-    if (m_angleDeg > 200)
+    if (m_angleRaw > KIDS_LEVEL_THRESHOLD_RAW)
     {
-      m_safe->setBarGraphResolution( BAR_GRAPH_RESOLUTION_KIDS_DEG);
-      m_safe->getAndDisplayAngles(m_targetAngleDegKids, m_angleDeg);
+      m_safe->setBarGraphResolution( BAR_GRAPH_RESOLUTION_KIDS_RAW);
+      m_safe->getAndDisplayAngles(m_targetAngleKidsRaw, m_angleRaw);
     }
     else
     {
-      m_safe->setBarGraphResolution( BAR_GRAPH_RESOLUTION_DEG);
-      m_safe->getAndDisplayAngles(m_targetAngleDeg, m_angleDeg);
+      m_safe->setBarGraphResolution( BAR_GRAPH_RESOLUTION_RAW);
+      m_safe->getAndDisplayAngles(m_targetAngleRaw, m_angleRaw);
     }
-    m_safe->getAndDisplayAngles(m_targetAngleDegKids, m_angleDeg);
 
     // Within tolerance?
-    if ((m_angleDeg < (m_targetAngleDegKids - ANGLE_HYSTERESYS_DEG_KIDS)) || (m_angleDeg > (m_targetAngleDegKids + ANGLE_HYSTERESYS_DEG_KIDS)))
+    if (angleRawDistance(m_angleRaw, m_targetAngleKidsRaw) > ANGLE_HYSTERESYS_KIDS_RAW)
     {
       stm_newState = STM_STATE_ACCURACY_GAME_OVER;
       stm_entryFlag = FALSE;
@@ -29,12 +29,21 @@ private:
   static constexpr float ANGLE_HYSTERESYS_MIN_SETTING_KIDS = 0.0;  /// Angle hyst in min
   static constexpr float ANGLE_HYSTERESYS_SEC_SETTING_KIDS = 0.0;  /// Angle hyst in sec
   static constexpr float ANGLE_HYSTERESYS_DEG_KIDS = ANGLE_HYSTERESYS_DEG_SETTING_KIDS +  (ANGLE_HYSTERESYS_MIN_SETTING_KIDS / 60.0) + (ANGLE_HYSTERESYS_SEC_SETTING_KIDS / 3600); /// Hysteresys of angle in degree
+
+  static constexpr float KIDS_LEVEL_THRESHOLD = 200.0;  /// Above this angle, the kids level is displayed
+
+  // Same settings in raw counts (2^32 per revolution), evaluated at compile time
+  static constexpr uint32_t TARGET_ANGLE_RAW              = angleDegToRaw(TARGET_ANGLE);
+  static constexpr uint32_t ANGLE_HYSTERESYS_RAW          = angleDegToRaw(ANGLE_HYSTERESYS_DEG);
+  static constexpr uint32_t TARGET_ANGLE_KIDS_RAW         = angleDegToRaw(TARGET_ANGLE_KIDS);
+  static constexpr uint32_t ANGLE_HYSTERESYS_KIDS_RAW     = angleDegToRaw(ANGLE_HYSTERESYS_DEG_KIDS);
+  static constexpr uint32_t KIDS_LEVEL_THRESHOLD_RAW      = angleDegToRaw(KIDS_LEVEL_THRESHOLD);
   
 	static const uint32_t DEBOUNCE_DELAY_ENCODER_MS = 5000;		/// This time defines, how long the correct code must be present
 	static const uint32_t SAFE_OPEN_TIME_MS = 5000;           /// How long is the safe open (coil)
 
-  static constexpr float BAR_GRAPH_RESOLUTION_DEG = 1.0;      /// Green bar graph resolution in degree
-  static constexpr float BAR_GRAPH_RESOLUTION_KIDS_DEG = 5.0;      /// Green bar graph resolution in degree
+  static constexpr uint32_t BAR_GRAPH_RESOLUTION_RAW      = angleDegToRaw(1.0);  /// Green bar graph resolution: 1 degree
+  static constexpr uint32_t BAR_GRAPH_RESOLUTION_KIDS_RAW = angleDegToRaw(5.0);  /// Green bar graph resolution: 5 degree
 
   static const uint32_t RGB_STRIP_ILLUMINATION_TIME_S = 15; /// How long should be the led in the safe on in seconds
 
@@ -59,15 +68,14 @@ private:
 	stm_bool_t             stm_exitFlag;    /// Flag for handling the exit action
 
 	uint8_t m_errorCode;
-	float m_angleDeg;
-	float m_offsetDeg;
+	uint32_t m_angleRaw;          /// Current angle relative to the zero position, raw counts
 	uint32_t m_lastDebounceTime;
 	uint16_t m_degree;
 	uint16_t m_minute;
 	uint16_t m_seconds;
 
-	float m_targetAngleDeg;
-  float m_targetAngleDegKids;
+	uint32_t m_targetAngleRaw;
+  uint32_t m_targetAngleKidsRaw;
 
 	Safe* m_safe;
 
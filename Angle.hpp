@@ -0,0 +1,93 @@
+// ****************************************************************************
+/// \file      Angle.hpp
+///
+/// \brief     Fixed-point angles
+///
+/// \details   Angles are kept as raw encoder counts, 2^32 counts per revolution.
+///            Differences are calculated modulo 2^32, so wrap-around at 0 / 360 degree
+///            needs no special case. Conversion to user units only at the edges
+///            (display, debug output). Conversions of constants are constexpr and
+///            evaluated by the compiler, no soft-double math at runtime.
+///
+/// \author    Christoph Capiaghi
+///
+/// \version   0.1
+///
+/// \date      20221017
+/// 
+/// \copyright Licensed under the Apache License, Version 2.0 (the "License");
+/// you may not use this file except in compliance with the License.
+/// You may obtain a copy of the License at
+/// http://www.apache.org/licenses/LICENSE-2.0
+///
+/// \pre       
+///
+/// \bug       
+///
+/// \warning   
+///
+/// \todo     
+///
+
+// Prevent recursive inclusion
+#pragma once
+
+#include <stdint.h>
+
+static const uint32_t ARC_SECONDS_PER_REVOLUTION = 360UL * 3600UL;
+
+// ----------------------------------------------------------------------------
+/// \brief     Degree to raw counts
+/// \detail    For constants only: evaluated at compile time
+/// \warning   angleDeg must be >= 0, 360 degree wraps to 0
+/// \return    Raw angle
+///
+constexpr uint32_t angleDegToRaw(const double angleDeg)
+{
+  return (uint32_t)(uint64_t)(angleDeg * (4294967296.0 / 360.0));
+}
+
+// ----------------------------------------------------------------------------
+/// \brief     Raw counts to arc seconds
+/// \detail    0 ... 1295999
+/// \warning   
+/// \return    Angle in arc seconds, truncated
+///
+inline uint32_t angleRawToArcSeconds(const uint32_t angleRaw)
+{
+  return (uint32_t)(((uint64_t)angleRaw * ARC_SECONDS_PER_REVOLUTION) >> 32);
+}
+
+// ----------------------------------------------------------------------------
+/// \brief     Raw counts to degree (single precision)
+/// \detail    Edge conversion for display and debug output
+/// \warning   
+/// \return    Angle 0 ... 360 degree
+///
+inline float angleRawToDeg(const uint32_t angleRaw)
+{
+  return (float)angleRaw * (360.0f / 4294967296.0f);
+}
+
+// ----------------------------------------------------------------------------
+/// \brief     Signed shortest difference a - b
+/// \detail    Modulo 2^32, correct across 0 / 360 degree
+/// \warning   
+/// \return    Difference in raw counts, -180 ... +180 degree
+///
+inline int32_t angleRawDifference(const uint32_t a, const uint32_t b)
+{
+  return (int32_t)(a - b);
+}
+
+// ----------------------------------------------------------------------------
+/// \brief     Absolute shortest distance between a and b
+/// \detail    
+/// \warning   
+/// \return    Distance in raw counts, 0 ... 180 degree
+///
+inline uint32_t angleRawDistance(const uint32_t a, const uint32_t b)
+{
+  uint32_t difference = a - b;
+  return (difference > 0x80000000UL) ? (0UL - difference) : difference;
+}
@@ -0,0 +1,154 @@
+// ****************************************************************************
+/// \file      AngleEstimator.cpp
+///
+/// \brief     Alpha-beta filter for the encoder angle
+///
+/// \details   Estimates angle and angular velocity from timestamped raw samples
+///            and predicts the angle at an arbitrary time. Works on raw counts
+///            (2^32 per revolution), the residual is calculated modulo 2^32.
+///
+/// \author    Christoph Capiaghi
+///
+/// \version   0.1
+///
+/// \date      20221017
+/// 
+/// \copyright Licensed under the Apache License, Version 2.0 (the "License");
+/// you may not use this file except in compliance with the License.
+/// You may obtain a copy of the License at
+/// http://www.apache.org/licenses/LICENSE-2.0
+///
+/// \pre       
+///
+/// \bug       
+///
+/// \warning   
+///
+/// \todo     
+///
+
+#include "AngleEstimator.hpp"
+#include "Angle.hpp"
+
+AngleEstimator::AngleEstimator() : m_alpha(0.5f),
+  m_beta(0.1f),
+  m_angle(0),
+  m_velocity(0.0f),
+  m_timestampUs(0),
+  m_valid(false)
+{
+
+}
+
+// ----------------------------------------------------------------------------
+/// \brief     Initialize filter gains
+/// \detail    Benedict-Bordner: beta = alpha^2 / (2 - alpha). Critically damped
+///            would be beta = (1 - sqrt(1 - alpha))^2
+/// \warning   
+/// \return    
+/// \todo      
+///
+void AngleEstimator::initialize(const float alpha, const float beta)
+{
+  m_alpha = alpha;
+  m_beta  = beta;
+  reset();
+}
+
+// ----------------------------------------------------------------------------
+/// \brief     Reset filter
+/// \detail    The next sample is taken as is, velocity zero
+/// \warning   
+/// \return    
+/// \todo      
+///
+void AngleEstimator::reset()
+{
+  m_velocity = 0.0f;
+  m_valid    = false;
+}
+
+// ----------------------------------------------------------------------------
+/// \brief     Feed a new sample
+/// \detail    Samples not newer than the current estimate are ignored, a gap
+///            above MAX_SAMPLE_GAP_US restarts the filter
+/// \warning   
+/// \return    
+/// \todo      
+///
+void AngleEstimator::update(const uint32_t rawAngle, const uint32_t timestampUs)
+{
+  uint32_t dtUs = timestampUs - m_timestampUs;
+  if (m_valid && (int32_t)dtUs <= 0) return; // Not newer than the estimate
+
+  if (!m_valid || dtUs > MAX_SAMPLE_GAP_US)
+  {
+    m_angle       = rawAngle;
+    m_velocity    = 0.0f;
+    m_timestampUs = timestampUs;
+    m_valid       = true;
+    return;
+  }
+
+  uint32_t predicted = predict(timestampUs);
+  float residual     = (float)angleRawDifference(rawAngle, predicted);
+
+  m_angle       = predicted + (int32_t)(m_alpha * residual);
+  m_velocity   += m_beta * residual / (float)dtUs;
+  m_timestampUs = timestampUs;
+}
+
+// ----------------------------------------------------------------------------
+/// \brief     Get estimated angle at the time of the last sample
+/// \detail    
+/// \warning   
+/// \return    Raw angle
+/// \todo      
+///
+uint32_t AngleEstimator::getAngle()
+{
+  return m_angle;
+}
+
+// ----------------------------------------------------------------------------
+/// \brief     Get estimated angular velocity
+/// \detail    
+/// \warning   
+/// \return    Raw counts per microsecond, positive: counting up
+/// \todo      
+///
+float AngleEstimator::getVelocity()
+{
+  return m_velocity;
+}
+
+// ----------------------------------------------------------------------------
+/// \brief     Predict the angle at a given time
+/// \detail    Linear extrapolation, the horizon is limited to MAX_PREDICTION_US
+/// \warning   
+/// \return    Raw angle
+/// \todo      
+///
+uint32_t AngleEstimator::predict(const uint32_t timestampUs)
+{
+  int32_t dtUs = (int32_t)(timestampUs - m_timestampUs);
+  if (dtUs >  (int32_t)MAX_PREDICTION_US) dtUs =  (int32_t)MAX_PREDICTION_US;
+  if (dtUs < -(int32_t)MAX_PREDICTION_US) dtUs = -(int32_t)MAX_PREDICTION_US;
+
+  float deltaRaw = m_velocity * (float)dtUs;
+  if (deltaRaw >  2147483520.0f) deltaRaw =  2147483520.0f; // Largest float below 2^31
+  if (deltaRaw < -2147483520.0f) deltaRaw = -2147483520.0f;
+  return m_angle + (int32_t)deltaRaw;
+}
+
+// ----------------------------------------------------------------------------
+/// \brief     Estimate valid?
+/// \detail    
+/// \warning   
+/// \return    true after the first sample
+/// \todo      
+///
+bool AngleEstimator::isValid()
+{
+  return m_valid;
+}
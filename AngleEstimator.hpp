@@ -0,0 +1,28 @@
+#pragma once
+
+#include <stdint.h>
+
+class AngleEstimator
+{
+public:
+
+    AngleEstimator();
+    void initialize(const float alpha, const float beta);
+    void reset();
+    void update(const uint32_t rawAngle, const uint32_t timestampUs);
+    uint32_t getAngle();
+    float getVelocity();
+    uint32_t predict(const uint32_t timestampUs);
+    bool isValid();
+
+private:
+    static const uint32_t MAX_PREDICTION_US = 100000;  /// Prediction horizon is limited to 100 ms
+    static const uint32_t MAX_SAMPLE_GAP_US = 100000;  /// Restart the filter after a longer gap
+
+    float    m_alpha;         /// Position gain 0 ... 1
+    float    m_beta;          /// Velocity gain 0 ... 2
+    uint32_t m_angle;         /// Estimated angle, raw counts
+    float    m_velocity;      /// Estimated angular velocity, raw counts per microsecond
+    uint32_t m_timestampUs;   /// Time of the estimate
+    bool     m_valid;         /// At least one sample seen
+};
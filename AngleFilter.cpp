@@ -0,0 +1,224 @@
+// ****************************************************************************
+/// \file      AngleFilter.cpp
+///
+/// \brief     Streaming filter for the encoder position
+///
+/// \details   Fed with every encoder sample (multi-turn position, see TurnTracker),
+///            read once per frame. A window of the last N samples gives a running
+///            median and a moving average. A sample further than the outlier
+///            threshold from the median is replaced by the median before it enters
+///            the average, so a single bad reading cannot move the output.
+///            Fixed memory, the cost per sample is bounded by MAX_WINDOW_LENGTH.
+///
+/// \author    Christoph Capiaghi
+///
+/// \version   0.1
+///
+/// \date      20221017
+///
+/// \copyright Licensed under the Apache License, Version 2.0 (the "License");
+/// you may not use this file except in compliance with the License.
+/// You may obtain a copy of the License at
+/// http://www.apache.org/licenses/LICENSE-2.0
+///
+/// \pre       
+///
+/// \bug       
+///
+/// \warning   The average lags by half a window while the knob is turned
+///
+/// \todo      
+///
+
+#include <string.h>
+#include "AngleFilter.hpp"
+#include "config.hpp"
+
+AngleFilter::AngleFilter() : m_windowLength(1),
+  m_outlierThresholdRaw(0),
+  m_head(0),
+  m_count(0),
+  m_acceptedSum(0),
+  m_samplesSinceOutput(0),
+  m_rejectedCount(0)
+{
+
+}
+
+// ----------------------------------------------------------------------------
+/// \brief     Initialize filter
+/// \detail    windowLength 1 ... MAX_WINDOW_LENGTH, 1: no filtering
+/// \warning   
+/// \return    
+/// \todo      
+///
+void AngleFilter::initialize(const uint8_t windowLength, const uint32_t outlierThresholdRaw)
+{
+  m_windowLength        = windowLength;
+  if (m_windowLength < 1) m_windowLength = 1;
+  if (m_windowLength > MAX_WINDOW_LENGTH) m_windowLength = MAX_WINDOW_LENGTH;
+  m_outlierThresholdRaw = outlierThresholdRaw;
+  reset();
+}
+
+// ----------------------------------------------------------------------------
+/// \brief     Reset filter
+/// \detail    Empty window, e.g. after a gap in the samples
+/// \warning   
+/// \return    
+/// \todo      
+///
+void AngleFilter::reset()
+{
+  m_head               = 0;
+  m_count              = 0;
+  m_acceptedSum        = 0;
+  m_samplesSinceOutput = 0;
+  m_rejectedCount      = 0;
+}
+
+// ----------------------------------------------------------------------------
+/// \brief     Feed a new sample
+/// \detail    The oldest sample leaves the window, the sorted copy is kept up to
+///            date by one binary search and one move each
+/// \warning   
+/// \return    
+/// \todo      
+///
+void AngleFilter::update(const int64_t positionRaw)
+{
+  // Outlier: the median of the window stands in for the average (from 3 samples on)
+  int64_t accepted = positionRaw;
+  if (m_outlierThresholdRaw > 0 && m_count >= 3)
+  {
+    int64_t median   = getMedian();
+    int64_t distance = (positionRaw > median) ? (positionRaw - median) : (median - positionRaw);
+    if (distance > (int64_t)m_outlierThresholdRaw)
+    {
+      accepted = median;
+      m_rejectedCount++;
+    }
+  }
+
+  if (m_count == m_windowLength)
+  {
+    // Drop the oldest sample
+    uint8_t index = findSorted(m_samples[m_head]);
+    memmove(&m_sorted[index], &m_sorted[index + 1], (m_count - index - 1) * sizeof(m_sorted[0]));
+    m_acceptedSum -= m_accepted[m_head];
+    m_count--;
+  }
+
+  // The raw sample goes into the median, so a real jump is followed after half a window
+  uint8_t index = findSorted(positionRaw);
+  memmove(&m_sorted[index + 1], &m_sorted[index], (m_count - index) * sizeof(m_sorted[0]));
+  m_sorted[index]    = positionRaw;
+  m_samples[m_head]  = positionRaw;
+  m_accepted[m_head] = accepted;
+  m_acceptedSum     += accepted;
+  m_count++;
+  m_head = (m_head + 1) % m_windowLength;
+
+  if (m_samplesSinceOutput < 0xFF) m_samplesSinceOutput++;
+}
+
+// ----------------------------------------------------------------------------
+/// \brief     Get moving average
+/// \detail    Outliers replaced by the median
+/// \warning   0 if no sample was received yet
+/// \return    Position in raw counts
+/// \todo      
+///
+int64_t AngleFilter::getMean()
+{
+  if (m_count == 0) return 0;
+  // Round to nearest, also for negative sums
+  int64_t half = (m_acceptedSum >= 0) ? (m_count / 2) : -(m_count / 2);
+  return (m_acceptedSum + half) / m_count;
+}
+
+// ----------------------------------------------------------------------------
+/// \brief     Get running median
+/// \detail    Even number of samples: mean of the two middle ones
+/// \warning   0 if no sample was received yet
+/// \return    Position in raw counts
+/// \todo      
+///
+int64_t AngleFilter::getMedian()
+{
+  if (m_count == 0) return 0;
+  if (m_count % 2) return m_sorted[m_count / 2];
+  int64_t low  = m_sorted[m_count / 2 - 1];
+  return low + (m_sorted[m_count / 2] - low) / 2;
+}
+
+// ----------------------------------------------------------------------------
+/// \brief     Decimated output, once per frame
+/// \detail    Moving average of the window. Starts a new decimation period.
+/// \warning   positionRaw is unchanged if no sample was received yet
+/// \return    RC_OK if new samples arrived since the last call,
+///            RC_STALE if the output is based on old samples only
+/// \todo      
+///
+uint8_t AngleFilter::getOutput(int64_t& positionRaw)
+{
+  if (m_count == 0) return RC_INV_UART1_TIMEOUT;
+  positionRaw = getMean();
+  uint8_t errorCode = (m_samplesSinceOutput > 0) ? RC_OK : RC_STALE;
+  m_samplesSinceOutput = 0;
+  return errorCode;
+}
+
+// ----------------------------------------------------------------------------
+/// \brief     Get number of samples in the window
+/// \detail    
+/// \warning   
+/// \return    0 ... window length
+/// \todo      
+///
+uint8_t AngleFilter::getNumberOfSamples()
+{
+  return m_count;
+}
+
+// ----------------------------------------------------------------------------
+/// \brief     Get number of rejected samples
+/// \detail    Since reset()
+/// \warning   
+/// \return    
+/// \todo      
+///
+uint32_t AngleFilter::getRejectedCount()
+{
+  return m_rejectedCount;
+}
+
+// ----------------------------------------------------------------------------
+/// \brief     Output valid?
+/// \detail    
+/// \warning   
+/// \return    true after the first sample
+/// \todo      
+///
+bool AngleFilter::isValid()
+{
+  return m_count > 0;
+}
+
+/// <summary>
+/// Binary search in the sorted window
+/// </summary>
+/// <param name="positionRaw">Value to look for</param>
+/// <returns>Index of the first element not less than positionRaw</returns>
+uint8_t AngleFilter::findSorted(const int64_t positionRaw)
+{
+  uint8_t low  = 0;
+  uint8_t high = m_count;
+  while (low < high)
+  {
+    uint8_t middle = (low + high) / 2;
+    if (m_sorted[middle] < positionRaw) low = middle + 1;
+    else high = middle;
+  }
+  return low;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <stdint.h>
+
+class AngleFilter
+{
+public:
+    static const uint8_t MAX_WINDOW_LENGTH = 32;   /// Upper limit of the window, fixed memory
+
+    AngleFilter();
+    void initialize(const uint8_t windowLength, const uint32_t outlierThresholdRaw);
+    void reset();
+    void update(const int64_t positionRaw);
+    int64_t getMean();
+    int64_t getMedian();
+    uint8_t getOutput(int64_t& positionRaw);
+    uint8_t getNumberOfSamples();
+    uint32_t getRejectedCount();
+    bool isValid();
+
+private:
+    uint8_t  m_windowLength;                   /// Samples in the window when full
+    uint32_t m_outlierThresholdRaw;            /// Max. distance to the median, 0: no rejection
+    int64_t  m_samples[MAX_WINDOW_LENGTH];     /// Ring buffer, samples as received
+    int64_t  m_accepted[MAX_WINDOW_LENGTH];    /// Ring buffer, outliers replaced by the median
+    int64_t  m_sorted[MAX_WINDOW_LENGTH];      /// m_samples in ascending order, for the median
+    uint8_t  m_head;                           /// Next slot in the ring buffers
+    uint8_t  m_count;                          /// Samples in the window
+    int64_t  m_acceptedSum;                    /// Running sum of m_accepted
+    uint8_t  m_samplesSinceOutput;             /// New samples since the last getOutput()
+    uint32_t m_rejectedCount;                  /// Outliers since reset()
+
+    uint8_t findSorted(const int64_t positionRaw);
+};
@@ -0,0 +1,287 @@
+// ****************************************************************************
+/// \file      BusCapture.cpp
+///
+/// \brief     Capture of the encoder link (Serial1)
+///
+/// \details   SerialHandler records every byte it writes and reads, with the
+///            time of the call, into a caller supplied buffer. Binary log:
+///            header "RBC", version, baud rate at the start (uint32, little endian),
+///            then one record per byte or begin():
+///            varint((time since the last record in us << 2) | type), then the
+///            payload: the data byte (RX / TX), or baud rate (uint32) and config
+///            (uint16) (CONFIG). The bytes of one request share their timestamp,
+///            so a record usually takes 2 bytes.
+///            dump() prints the log as hex on the debug port, "xxd -r -p" turns it
+///            back into binary for the replay of sim/encoder_sim.
+///
+/// \author    Christoph Capiaghi
+///
+/// \version   0.1
+///
+/// \date      20221017
+///
+/// \copyright Licensed under the Apache License, Version 2.0 (the "License");
+/// you may not use this file except in compliance with the License.
+/// You may obtain a copy of the License at
+/// http://www.apache.org/licenses/LICENSE-2.0
+///
+/// \pre
+///
+/// \bug
+///
+/// \warning   RX bytes carry the time they were read, not the time they arrived.
+///            A full buffer stops recording, the following records are counted
+///            as lost.
+///
+/// \todo
+///
+
+#include <arduino.h>
+#include "BusCapture.hpp"
+#include "config.hpp"
+#include "Crc8.hpp"
+
+static const uint8_t CAPTURE_MAGIC[] = { 'R', 'B', 'C' };
+static const uint8_t TYPE_BITS = 2;
+static const uint8_t MAX_TIME_LENGTH = 5;   /// Varint of a 32 bit time difference and the type
+
+BusCapture::BusCapture() : m_buffer(0),
+  m_size(0),
+  m_length(0),
+  m_lastTimeUs(0),
+  m_recordCount(0),
+  m_lostCount(0),
+  m_running(false)
+{
+
+}
+
+// ----------------------------------------------------------------------------
+/// \brief     Initialize capture
+/// \detail    The log is written into buffer, not started yet
+/// \warning
+/// \return    RC_Type
+/// \todo
+///
+uint8_t BusCapture::initialize(uint8_t buffer[], const uint32_t size)
+{
+  if (buffer == 0 || size < HEADER_LENGTH + MAX_RECORD_LENGTH) return RC_INV_PARAM;
+  m_buffer  = buffer;
+  m_size    = size;
+  m_length  = 0;
+  m_running = false;
+  return RC_OK;
+}
+
+// ----------------------------------------------------------------------------
+/// \brief     Start a new capture
+/// \detail    Discards the last one. baudrate: current rate of the link
+/// \warning
+/// \return
+/// \todo
+///
+void BusCapture::start(const unsigned long baudrate)
+{
+  if (m_buffer == 0) return;
+  m_length = 0;
+  for (uint8_t i = 0; i < sizeof(CAPTURE_MAGIC); i++)
+  {
+    m_buffer[m_length++] = CAPTURE_MAGIC[i];
+  }
+  m_buffer[m_length++] = FORMAT_VERSION;
+  putUint32(baudrate);
+  m_recordCount = 0;
+  m_lostCount   = 0;
+  m_lastTimeUs  = micros();
+  m_running     = true;
+}
+
+void BusCapture::stop()
+{
+  m_running = false;
+}
+
+bool BusCapture::isRunning()
+{
+  return m_running;
+}
+
+void BusCapture::recordRx(const uint8_t data)
+{
+  if (beginRecord(BUS_CAPTURE_RX, 1)) m_buffer[m_length++] = data;
+}
+
+void BusCapture::recordTx(const uint8_t data[], const uint8_t length)
+{
+  for (uint8_t i = 0; i < length; i++)
+  {
+    if (beginRecord(BUS_CAPTURE_TX, 1)) m_buffer[m_length++] = data[i];
+  }
+}
+
+void BusCapture::recordConfig(const unsigned long baudrate, const uint16_t config)
+{
+  if (!beginRecord(BUS_CAPTURE_CONFIG, 6)) return;
+  putUint32(baudrate);
+  m_buffer[m_length++] = (uint8_t)config;
+  m_buffer[m_length++] = (uint8_t)(config >> 8);
+}
+
+const uint8_t* BusCapture::getData()
+{
+  return m_buffer;
+}
+
+// ----------------------------------------------------------------------------
+/// \brief     Get length of the log
+/// \detail    Header included, 0 if never started
+/// \warning
+/// \return    Bytes
+/// \todo
+///
+uint32_t BusCapture::getLength()
+{
+  return m_length;
+}
+
+uint32_t BusCapture::getRecordCount()
+{
+  return m_recordCount;
+}
+
+// ----------------------------------------------------------------------------
+/// \brief     Get number of records lost
+/// \detail    Buffer full, the capture ends with the last stored record
+/// \warning
+/// \return
+/// \todo
+///
+uint32_t BusCapture::getLostCount()
+{
+  return m_lostCount;
+}
+
+// ----------------------------------------------------------------------------
+/// \brief     Print the log on the debug port
+/// \detail    Stops the capture. One summary line with the CRC8 of the log (to check
+///            the copy), then the log as hex, 32 bytes per line
+/// \warning   Blocking, takes a while for a large log
+/// \return
+/// \todo
+///
+void BusCapture::dump()
+{
+  stop();
+  Serial.print(F("Capture: "));
+  Serial.print(m_length);
+  Serial.print(F(" bytes, records: "));
+  Serial.print(m_recordCount);
+  Serial.print(F(", lost: "));
+  Serial.print(m_lostCount);
+  Serial.print(F(", crc8: "));
+  Serial.println(Crc8::computeSlice8(m_buffer, m_length), HEX);
+  for (uint32_t i = 0; i < m_length; i++)
+  {
+    if (m_buffer[i] < 0x10) Serial.print('0');
+    Serial.print(m_buffer[i], HEX);
+    if ((i % 32) == 31 || i + 1 == m_length) Serial.println();
+  }
+}
+
+// ----------------------------------------------------------------------------
+/// \brief     Check the header of a log
+/// \detail
+/// \warning
+/// \return    RC_OK and the baud rate at the start, RC_INV_PARAM if no capture
+/// \todo
+///
+uint8_t BusCapture::checkHeader(const uint8_t data[], const uint32_t length, unsigned long &baudrate)
+{
+  if (length < HEADER_LENGTH) return RC_INV_PARAM;
+  for (uint8_t i = 0; i < sizeof(CAPTURE_MAGIC); i++)
+  {
+    if (data[i] != CAPTURE_MAGIC[i]) return RC_INV_PARAM;
+  }
+  if (data[3] != FORMAT_VERSION) return RC_INV_PARAM;
+  baudrate = (uint32_t)data[4] | ((uint32_t)data[5] << 8) | ((uint32_t)data[6] << 16) | ((uint32_t)data[7] << 24);
+  return RC_OK;
+}
+
+// ----------------------------------------------------------------------------
+/// \brief     Decode the record at offset
+/// \detail    Start with offset = HEADER_LENGTH and record.timeUs = 0, then pass
+///            the last record again: its time is the base of the next one.
+/// \warning
+/// \return    RC_OK and offset behind the record,
+///            RC_INV_UART1_LENGTH if the record is truncated, RC_INV_PARAM if unknown
+/// \todo
+///
+uint8_t BusCapture::decode(const uint8_t data[], const uint32_t length, uint32_t &offset, bus_capture_record_t &record)
+{
+  uint64_t value = 0;
+  uint8_t shift = 0;
+  uint32_t i = offset;
+  while (true)
+  {
+    if (i >= length || shift >= 7 * MAX_TIME_LENGTH) return RC_INV_UART1_LENGTH;
+    value |= (uint64_t)(data[i] & 0x7F) << shift;
+    shift += 7;
+    if ((data[i++] & 0x80) == 0) break;
+  }
+
+  uint8_t type = (uint8_t)(value & ((1U << TYPE_BITS) - 1));
+  uint8_t payloadLength = (type == BUS_CAPTURE_CONFIG) ? 6 : 1;
+  if (type > BUS_CAPTURE_CONFIG) return RC_INV_PARAM;
+  if (i + payloadLength > length) return RC_INV_UART1_LENGTH;
+
+  record.type    = type;
+  record.timeUs += (uint32_t)(value >> TYPE_BITS);
+  if (type == BUS_CAPTURE_CONFIG)
+  {
+    record.baudrate = (uint32_t)data[i] | ((uint32_t)data[i + 1] << 8) | ((uint32_t)data[i + 2] << 16) | ((uint32_t)data[i + 3] << 24);
+    record.config   = (uint16_t)(data[i + 4] | (data[i + 5] << 8));
+  }
+  else
+  {
+    record.data = data[i];
+  }
+  offset = i + payloadLength;
+  return RC_OK;
+}
+
+/// <summary>
+/// Writes time and type of a new record, if the record fits
+/// </summary>
+/// <returns>false if not recording or the buffer is full</returns>
+bool BusCapture::beginRecord(const uint8_t type, const uint8_t payloadLength)
+{
+  if (!m_running) return false;
+  if (m_length + MAX_TIME_LENGTH + payloadLength > m_size)
+  {
+    m_lostCount++;
+    return false;
+  }
+  uint32_t now = micros();
+  uint64_t value = ((uint64_t)(now - m_lastTimeUs) << TYPE_BITS) | type;
+  m_lastTimeUs = now;
+  do
+  {
+    uint8_t data = value & 0x7F;
+    value >>= 7;
+    if (value != 0) data |= 0x80;
+    m_buffer[m_length++] = data;
+  } while (value != 0);
+  m_recordCount++;
+  return true;
+}
+
+/// <summary>
+/// Appends a little endian uint32
+/// </summary>
+void BusCapture::putUint32(const uint32_t value)
+{
+  m_buffer[m_length++] = (uint8_t)value;
+  m_buffer[m_length++] = (uint8_t)(value >> 8);
+  m_buffer[m_length++] = (uint8_t)(value >> 16);
+  m_buffer[m_length++] = (uint8_t)(value >> 24);
+}
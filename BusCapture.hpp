@@ -0,0 +1,58 @@
+#pragma once
+
+#include <stdint.h>
+
+/// \brief Kinds of capture records
+typedef enum bus_capture_type_e
+{
+  BUS_CAPTURE_RX     = 0,   /// Byte read from the encoder
+  BUS_CAPTURE_TX     = 1,   /// Byte written to the encoder
+  BUS_CAPTURE_CONFIG = 2,   /// begin(): new baud rate and frame format
+} bus_capture_type_t;
+
+/// \brief One decoded capture record
+typedef struct bus_capture_record_s
+{
+  uint8_t  type;       /// bus_capture_type_t
+  uint32_t timeUs;     /// Time since the start of the capture
+  uint8_t  data;       /// RX / TX byte
+  uint32_t baudrate;   /// CONFIG only
+  uint16_t config;     /// CONFIG only, SERIAL_8N1 ...
+} bus_capture_record_t;
+
+class BusCapture
+{
+public:
+    static const uint8_t HEADER_LENGTH     = 8;    /// "RBC", version, baud rate at the start
+    static const uint8_t FORMAT_VERSION    = 1;
+    static const uint8_t MAX_RECORD_LENGTH = 11;   /// 5 byte time / type + baud rate + config
+
+    BusCapture();
+    uint8_t initialize(uint8_t buffer[], const uint32_t size);
+    void start(const unsigned long baudrate);
+    void stop();
+    bool isRunning();
+    void recordRx(const uint8_t data);
+    void recordTx(const uint8_t data[], const uint8_t length);
+    void recordConfig(const unsigned long baudrate, const uint16_t config);
+    const uint8_t* getData();
+    uint32_t getLength();
+    uint32_t getRecordCount();
+    uint32_t getLostCount();
+    void dump();
+
+    static uint8_t checkHeader(const uint8_t data[], const uint32_t length, unsigned long &baudrate);
+    static uint8_t decode(const uint8_t data[], const uint32_t length, uint32_t &offset, bus_capture_record_t &record);
+
+private:
+    uint8_t* m_buffer;
+    uint32_t m_size;
+    uint32_t m_length;           /// Bytes used, header included
+    uint32_t m_lastTimeUs;       /// Time of the last record, records store the difference
+    uint32_t m_recordCount;
+    uint32_t m_lostCount;        /// Records not stored, buffer full
+    volatile bool m_running;
+
+    bool beginRecord(const uint8_t type, const uint8_t payloadLength);
+    void putUint32(const uint32_t value);
+};
@@ -28,22 +28,66 @@
 #include <arduino.h>
 #include "Encoder.hpp"
 #include "config.hpp"
+#include "RomerCodec.hpp"
 #include <stdint.h>
-extern "C" {
-#include "crc8.h"
-}
+#include <string.h>
 
 
-Encoder::Encoder() : m_rawAngle(0), m_initStatus(INIT_NOT_COMPLETE)
+Encoder::Encoder() : m_initStatus(INIT_NOT_COMPLETE), m_rawAngle(0),
+  m_angleStatus(RC_INV_UART1_TIMEOUT),
+  m_sampleCount(0),
+  m_anglesPerRequest(1),
+  m_batchLength(0),
+  m_pipelineMode(false),
+  m_autoTrigger(true),
+  m_hardwareTrigger(false),
+  m_latchTimeUs(0),
+  m_deviceAddress(ROMER_BROADCAST_ADDRESS),
+  m_linkState(ENCODER_LINK_UP),
+  m_consecutiveFailures(0),
+  m_backoffMs(BREAKER_BACKOFF_MIN_MS),
+  m_nextProbeMs(0),
+  m_lastValidSampleMs(0),
+  m_downBaudrate(ENCODER_UART_SPEED),
+  m_probeCount(0),
+  m_negotiatedBaudrate(0),
+  m_restorePending(false),
+  m_discardedBytes(0),
+  m_transactionState(ROMER_TRANSACTION_IDLE),
+  m_parser(),
+  m_rxFrame(0),
+  m_rxCount(0),
+  m_rxExpected(0),
+  m_rxErrorCode(RC_OK),
+  m_angleRetries(0),
+  m_charTimeUs(0),
+  m_txTimeUs(0),
+  m_lastRxTimeUs(0),
+  m_firstRxTimeUs(0),
+  m_frameDeadlineUs(0),
+  m_captureTimeUs(0),
+  m_minTurnaroundUs(0xFFFFFFFF),
+  m_windowTurnaroundUs(0xFFFFFFFF),
+  m_turnaroundCount(0),
+  m_registerCacheValid(0)
 {
+  buildRequests();
+  resetLinkStats();
 
 }
 
 // ----------------------------------------------------------------------------
 /// \brief     Initialize Encoder
-/// \detail    Set encoder to 8-bit, ASCII Mode and checks, if register access was successfully
-/// \warning   
-/// \return    RC_Type
+/// \detail    Probes with one G command, if the encoder is already in 8-bit binary mode.
+///            Only if not, the parity switch (setEightBitMode) is done, followed by a few
+///            probes. Repeated until the encoder answers or ENCODER_POWER_UP_TIMEOUT_MS
+///            is over, so the power-on time of the encoder is measured, not guessed.
+///            Fetches a first angle, so a valid sample is present before the first update()
+///            If the encoder does not answer, the link starts in the down state and is
+///            probed in the background by update() / getRawAngle().
+/// \warning   Blocking, but every transaction is bounded by its deadlines
+/// \return    RC_OK if the first sample is valid, else its error code.
+///            RC_INV_UART1_TIMEOUT and isDegraded() if the encoder did not answer
 /// \todo      
 ///
 uint8_t Encoder::initialize(SerialHandler *serialHandler)
@@ -55,37 +99,48 @@ Serial.println("Encoder Init");
   m_serialHandler = serialHandler;
 
   if (m_initStatus == INIT_COMPLETE) return RC_OK;
- 
-  uint8_t retries = 0;
-  uint8_t validCmd = INVALID_CODE;
-  while (validCmd != CORRECT_CODE)
-  {
-    setEightBitMode();
-    sendRomerGCmd(); // Check if eight bit mode was successfully done
-    uint8_t recBufferLength = 8;
-    uint8_t recBuffer[recBufferLength];
-    readRomerCmd(recBuffer, recBufferLength);
+  m_parser.initialize(m_serialHandler);
+
+  // Character time on the link, rounded up
+  unsigned long baudrate = m_serialHandler->getBaudrate();
+  m_charTimeUs = (UART_BITS_PER_CHAR * 1000000UL + baudrate - 1) / baudrate;
 
-    if (recBuffer[ROMER_COMMAND_FIELD_RX] == ROMER_CMD_G_TX)
+  uint32_t startTimeMs = millis();
+  uint8_t numberOfSwitches = 0;
+  bool validCmd = probeEightBitMode();
+  while (!validCmd)
+  {
+    if ((millis() - startTimeMs) > ENCODER_POWER_UP_TIMEOUT_MS)
     {
-#ifdef DEBUG
-        Serial.println(F("Valid command received (setEightBitMode)"));
-#endif
-        validCmd = CORRECT_CODE;
+      openBreaker();
+      m_initStatus = INIT_COMPLETE;
+      return RC_INV_UART1_TIMEOUT;
     }
-    else
+
+    setEightBitMode();
+    numberOfSwitches++;
+    for (uint8_t probe = 0; probe < PROBES_PER_MODE_SWITCH && !validCmd; probe++)
     {
-        if (retries > NUMBER_OF_RETRIES) return RC_INV_UART1_TIMEOUT;
-        delay(EIGHT_BIT_MODE_WAIT_TIME_MS);
-        retries++;
+      m_stats.retries++;
+      validCmd = probeEightBitMode();
     }
+  }
 #ifdef DEBUG
-      Serial.print(F("Number of retries (setEightBitMode): "));
-      Serial.println(retries);
+  Serial.print(F("Encoder ready after ms: "));
+  Serial.println(millis() - startTimeMs);
+  Serial.print(F("Number of mode switches (setEightBitMode): "));
+  Serial.println(numberOfSwitches);
 #endif
-  }
 
-   return RC_OK;
+  // First sample
+  sendRomerBCmd();
+  m_angleStatus = waitTransaction();
+  if (m_angleStatus == RC_OK) m_angleStatus = decodeAngles(m_rxFrame);
+  releaseFrame();
+  updateLinkState(m_angleStatus);
+
+  m_initStatus = INIT_COMPLETE;
+  return m_angleStatus;
 }
 
 // ----------------------------------------------------------------------------
@@ -97,13 +152,14 @@ Serial.println("Encoder Init");
 ///
 uint8_t Encoder::getAngleDeg(float &angleDeg)
 {
-	getAngle(m_rawAngle);
-	angleDeg = (float)((m_rawAngle / pow(2,32)) * (360.0));
- #ifdef DEBUG
+  uint32_t rawAngle;
+	uint8_t errorCode = getRawAngle(rawAngle);
+	angleDeg = angleRawToDeg(rawAngle);
+ #ifdef DEBUG_VERBOSE
      Serial.print(F("Encoder Angle in Degree: "));
      Serial.println(angleDeg, 8);
 #endif
-	return RC_OK;
+	return errorCode;
 }
 
 // ----------------------------------------------------------------------------
@@ -115,13 +171,14 @@ uint8_t Encoder::getAngleDeg(float &angleDeg)
 ///
 uint8_t Encoder::getAngleRad(float &angleDeg)
 {
-  getAngle(m_rawAngle);
-  angleDeg = (float)((m_rawAngle / pow(2,32)) * (2*PI));
- #ifdef DEBUG
+  uint32_t rawAngle;
+  uint8_t errorCode = getRawAngle(rawAngle);
+  angleDeg = (float)rawAngle * (2.0f * (float)PI / 4294967296.0f);
+ #ifdef DEBUG_VERBOSE
      Serial.print(F("Encoder Angle in Degree: "));
      Serial.println(angleDeg, 8);
 #endif
-  return RC_OK;
+  return errorCode;
 }
 
 // ----------------------------------------------------------------------------
@@ -133,118 +190,1077 @@ uint8_t Encoder::getAngleRad(float &angleDeg)
 ///
 uint8_t Encoder::getAngleGon(float &angleGon)
 {
-	getAngle(m_rawAngle);
-	angleGon = (float)((m_rawAngle / pow(2,32)) * (400.0));
-	return RC_OK;
+  uint32_t rawAngle;
+	uint8_t errorCode = getRawAngle(rawAngle);
+	angleGon = (float)rawAngle * (400.0f / 4294967296.0f);
+	return errorCode;
 }
 
 // ----------------------------------------------------------------------------
 /// \brief     Get Encoder raw Angle
-/// \detail    Send Romer CMD B -> SW Trigger and get Trigger
+/// \detail    Drives the transaction engine and returns the latest completed sample.
+///            Never waits for the bus: the sample is at most one transaction old.
+///            Without pipeline mode the next sample is requested by the first call that
+///            finds the bus idle, not by the call that collected the last reply, so the
+///            round-trip runs while the caller works. Pipeline mode requests it at once.
+///            2^32 counts per revolution, see Angle.hpp
 /// \warning   
-/// \return    RC_OK if return command was valid
+/// \return    RC_OK if the last completed transaction was valid,
+///            RC_STALE if the link is down and rawAngle is the last good sample
 /// \todo  
 ///    
-uint8_t Encoder::getAngle(uint32_t &rawAngle)
+uint8_t Encoder::getRawAngle(uint32_t &rawAngle)
+{
+  bool idle = (m_transactionState == ROMER_TRANSACTION_IDLE);
+  update();
+  if (m_autoTrigger && idle && m_transactionState == ROMER_TRANSACTION_IDLE) requestAngles(); // Request the next sample
+  rawAngle = m_rawAngle;
+  if (isDegraded()) return (m_sampleCount > 0) ? RC_STALE : RC_INV_UART1_TIMEOUT;
+	return m_angleStatus;
+}
+
+// ----------------------------------------------------------------------------
+/// \brief     Get latest sample with capture timestamp
+/// \detail    Same as getRawAngle(), the sample carries its capture time
+/// \warning   
+/// \return    RC_OK if the last completed transaction was valid
+/// \todo      
+///
+uint8_t Encoder::getSample(encoder_sample_t &sample)
+{
+  uint32_t rawAngle;
+  uint8_t errorCode = getRawAngle(rawAngle);
+  sample = (m_batchLength > 0) ? m_batch[m_batchLength - 1] : encoder_sample_t();
+  sample.rawAngle = rawAngle;
+  return errorCode;
+}
+
+// ----------------------------------------------------------------------------
+/// \brief     Drive the transaction engine
+/// \detail    Collects the reply of a pending B command. A corrupted reply (CRC8, length)
+///            is repeated at once (ANGLE_RETRIES), the caller only sees the result.
+///            Pipeline mode: the next B command (SW Trigger) is sent as soon as the reply
+///            is in, before it is decoded. Decoding and rendering of sample N then overlap
+///            with the bus round-trip of sample N+1.
+/// \warning   Call as often as possible (e.g. while waiting for the next frame). Never blocks.
+/// \return    RC_BUSY while a reply is pending, else status of the last angle transaction
+/// \todo      
+///
+uint8_t Encoder::update()
 {
-// First: Send CMD
+  if (m_transactionState != ROMER_TRANSACTION_WAIT_REPLY)
+  {
+    // Restart the pipeline, e.g. after a register access or when a probe is due
+    if (m_pipelineMode && m_autoTrigger && m_initStatus == INIT_COMPLETE) requestAngles();
+    return m_angleStatus;
+  }
+
+  uint8_t errorCode = pollTransaction();
+  if (errorCode == RC_BUSY) return RC_BUSY;
+  updateLinkState(errorCode);
+
+  bool corrupted = (errorCode == RC_INV_UART1_CRC || errorCode == RC_INV_UART1_LENGTH);
+  if (corrupted && m_angleRetries < ANGLE_RETRIES && (m_autoTrigger || m_hardwareTrigger) && !isDegraded())
+  {
+    // Same request again, in hardware trigger mode the latched angle is still there
+    m_angleRetries++;
+    m_stats.retries++;
     sendRomerBCmd();
+    return RC_BUSY;
+  }
+  m_angleRetries = 0;
+
+  if (errorCode == RC_OK)
+  {
+    errorCode = decodeAngles(m_rxFrame);
+  }
+  releaseFrame();
+  if (m_pipelineMode && m_autoTrigger) requestAngles();
 
-  uint8_t recBufferLength = 9;
-  uint8_t recBuffer[recBufferLength];
-  //Romer Protocol
-  // | Address Field | Length | Command | Register LSB | Register | Register | Register MSB | CRC
-  // Supported Protocol
-  // | 0xXX         | 0x06   | 0x47    | XX            |  XX      | XX       | XX           | XX
-  readRomerCmd(recBuffer, recBufferLength);
+  m_angleStatus = errorCode;
+  return m_angleStatus;
+}
 
-  if(recBuffer[ROMER_LENGTH_FIELD_RX] != ROMER_CMD_B_LENGTH_RX) return RC_INV_UART1_LENGTH;
-  if(recBuffer[ROMER_COMMAND_FIELD_RX] != ROMER_CMD_B_RX)       return RC_INV_UART1_COMMAND;
+// ----------------------------------------------------------------------------
+/// \brief     Enable pipelined acquisition
+/// \detail    
+/// \warning   
+/// \return    
+/// \todo      
+///
+void Encoder::setPipelineMode(const bool enable)
+{
+  m_pipelineMode = enable;
+  if (m_pipelineMode && m_autoTrigger && m_initStatus == INIT_COMPLETE && m_transactionState == ROMER_TRANSACTION_IDLE)
+  {
+    requestAngles();
+  }
+}
 
-  // 4* uint8_t to uint32_t
-  rawAngle = (recBuffer[ROMER_ANGLE4_MSB_FIELD_RX]<<24) | (recBuffer[ROMER_ANGLE3_FIELD_RX]<<16) | (recBuffer[ROMER_ANGLE2_FIELD_RX]<<8) | recBuffer[ROMER_ANGLE1_LSB_FIELD_RX];
-#ifdef DEBUG
+// ----------------------------------------------------------------------------
+/// \brief     Set slave address on the RS-485 bus
+/// \detail    1 ... 14 for one of several encoders on the bus, 0: broadcast (single encoder)
+/// \warning   Set before initialize()
+/// \return    RC_OK, RC_INV_UART1_ADDRESS if out of range
+/// \todo      
+///
+uint8_t Encoder::setDeviceAddress(const uint8_t deviceAddress)
+{
+  if (deviceAddress > ROMER_MAX_SLAVE_ADDRESS) return RC_INV_UART1_ADDRESS;
+  m_deviceAddress = deviceAddress;
+  buildRequests();
+  return RC_OK;
+}
+
+uint8_t Encoder::getDeviceAddress()
+{
+  return m_deviceAddress;
+}
+
+// ----------------------------------------------------------------------------
+/// \brief     Enable self triggering
+/// \detail    Disabled if the bus is shared and an EncoderBus schedules the requests
+/// \warning   
+/// \return    
+/// \todo      
+///
+void Encoder::setAutoTrigger(const bool enable)
+{
+  m_autoTrigger = enable;
+}
+
+// ----------------------------------------------------------------------------
+/// \brief     Trigger a new angle
+/// \detail    Sends the B command if no transaction is pending
+/// \warning   
+/// \return    RC_OK if triggered, RC_BUSY if a transaction is pending,
+///            RC_INV_UART1_TIMEOUT if the link is down and no probe is due
+/// \todo      
+///
+uint8_t Encoder::trigger()
+{
+  if (m_transactionState != ROMER_TRANSACTION_IDLE) return RC_BUSY;
+  requestAngles();
+  return (m_transactionState == ROMER_TRANSACTION_WAIT_REPLY) ? RC_OK : RC_INV_UART1_TIMEOUT;
+}
+
+// ----------------------------------------------------------------------------
+/// \brief     Enable the hardware trigger input of the encoder
+/// \detail    The encoder latches its angle on the rising edge of TRIGGER_PIN, a B command
+///            returns the latched angle. The samples get the edge time as timestamp
+///            instead of the estimated midpoint of end of request and start of reply.
+///            Register ENCODER_TRIGGER_MODE_REGISTER (config.hpp)
+/// \warning   Blocking. Turn off auto trigger and pipeline mode, the readouts must
+///            follow the pulses (EncoderSampler does this).
+/// \return    RC_Type
+/// \todo      
+///
+uint8_t Encoder::setHardwareTrigger(const bool enable)
+{
+  uint32_t value = enable ? 1 : 0;
+  uint8_t errorCode = writeRegisters(ENCODER_TRIGGER_MODE_REGISTER, 1, &value);
+  if (errorCode != RC_OK) return errorCode;
+  m_hardwareTrigger = enable;
+  return RC_OK;
+}
+
+// ----------------------------------------------------------------------------
+/// \brief     Read the angle latched by a trigger pulse
+/// \detail    Sends the B command, the samples of the reply are stamped with latchTimeUs
+/// \warning   Hardware trigger mode only. A power cycled encoder is back in free running
+///            mode until setHardwareTrigger() is called again.
+/// \return    RC_OK if sent, RC_BUSY if a transaction is pending,
+///            RC_INV_UART1_TIMEOUT if the link is down and no probe is due
+/// \todo      
+///
+uint8_t Encoder::readLatchedAngles(const uint32_t latchTimeUs)
+{
+  if (m_transactionState != ROMER_TRANSACTION_IDLE) return RC_BUSY;
+  m_latchTimeUs = latchTimeUs;
+  return trigger();
+}
+
+uint32_t Encoder::getTransactionCount()
+{
+  return m_stats.transactions;
+}
+
+uint32_t Encoder::getErrorCount()
+{
+  return m_stats.errors;
+}
+
+// ----------------------------------------------------------------------------
+/// \brief     Is the encoder link down?
+/// \detail    After BREAKER_FAILURE_THRESHOLD failed angle transactions in a row no
+///            request is sent until the next probe. Probes back off exponentially
+///            from BREAKER_BACKOFF_MIN_MS to BREAKER_BACKOFF_MAX_MS.
+/// \warning   
+/// \return    true while the link is down or a probe is running
+/// \todo      
+///
+bool Encoder::isDegraded()
+{
+  return m_linkState != ENCODER_LINK_UP;
+}
+
+// ----------------------------------------------------------------------------
+/// \brief     Is the last good sample too old?
+/// \detail    Link down or no valid angle for STALE_SAMPLE_MS
+/// \warning   
+/// \return    
+/// \todo      
+///
+bool Encoder::isStale()
+{
+  return isDegraded() || m_sampleCount == 0 || (millis() - m_lastValidSampleMs) > STALE_SAMPLE_MS;
+}
+
+// ----------------------------------------------------------------------------
+/// \brief     Link health counters and round-trip histogram
+/// \detail    Maintained by the transaction engine, a few increments per transaction
+/// \warning   
+/// \return    Statistics since start or resetLinkStats()
+/// \todo      
+///
+const encoder_link_stats_t& Encoder::getLinkStats()
+{
+  return m_stats;
+}
+
+void Encoder::resetLinkStats()
+{
+  memset(&m_stats, 0, sizeof(m_stats));
+  m_stats.minRoundTripUs = 0xFFFFFFFF;
+  m_discardedBytes = m_parser.getDiscardedBytes();
+}
+
+// ----------------------------------------------------------------------------
+/// \brief     Print the link statistics on the debug port
+/// \detail    One line of counters, one line of RX ring losses (shared by all encoders
+///            on the bus), one line of histogram buckets
+/// \warning   Takes a few ms at UART_SPEED, call on demand only
+/// \return    
+/// \todo      
+///
+void Encoder::printLinkStats()
+{
+  Serial.print(F("Encoder link: transactions "));  Serial.print(m_stats.transactions);
+  Serial.print(F(" valid "));                       Serial.print(m_stats.validFrames);
+  Serial.print(F(" errors "));                      Serial.print(m_stats.errors);
+  Serial.print(F(" (timeout "));                    Serial.print(m_stats.timeouts);
+  Serial.print(F(" crc "));                         Serial.print(m_stats.crcErrors);
+  Serial.print(F(" length "));                      Serial.print(m_stats.lengthErrors);
+  Serial.print(F(" command "));                     Serial.print(m_stats.commandErrors);
+  Serial.print(F(" address "));                     Serial.print(m_stats.addressErrors);
+  Serial.print(F(") retries "));                    Serial.print(m_stats.retries);
+  Serial.print(F(" resyncs "));                     Serial.println(m_stats.resyncs);
+  if (m_serialHandler)
+  {
+    Serial.print(F("RX ring: overruns "));            Serial.print(m_serialHandler->getRxOverrunCount());
+    Serial.print(F(" dropped bytes "));               Serial.println(m_serialHandler->getRxDroppedCount());
+  }
+
+  Serial.print(F("Round-trip us: min "));
+  Serial.print(m_stats.validFrames ? m_stats.minRoundTripUs : 0);
+  Serial.print(F(" max "));                         Serial.println(m_stats.maxRoundTripUs);
+  for (uint8_t i = 0; i < ENCODER_LATENCY_BUCKETS; i++)
+  {
+    Serial.print(i * ENCODER_LATENCY_BUCKET_US);
+    Serial.print((i < ENCODER_LATENCY_BUCKETS - 1) ? F("- ") : F("+ "));
+    Serial.print(m_stats.latencyHistogram[i]);
+    Serial.print(F(" "));
+  }
+  Serial.println();
+}
+
+// ----------------------------------------------------------------------------
+/// \brief     Get number of valid samples
+/// \detail    Used by consumers to detect a new sample
+/// \warning   Wraps around after 2^32 samples
+/// \return    Number of valid samples since start
+/// \todo      
+///
+uint32_t Encoder::getSampleCount()
+{
+  return m_sampleCount;
+}
+
+// ----------------------------------------------------------------------------
+/// \brief     Transaction pending?
+/// \detail    
+/// \warning   
+/// \return    true if a request is on the bus and the reply is not yet complete
+/// \todo      
+///
+bool Encoder::isBusy()
+{
+  return m_transactionState != ROMER_TRANSACTION_IDLE;
+}
+
+// ----------------------------------------------------------------------------
+/// \brief     Set number of angles per B command
+/// \detail    The encoder returns N angles in one reply. The request header, CRC and
+///            bus turnaround are shared by all of them. Takes effect with the next request.
+/// \warning   
+/// \return    RC_OK, RC_INV_UART1_LENGTH if numberOfAngles is out of range
+/// \todo      
+///
+uint8_t Encoder::setAnglesPerRequest(const uint8_t numberOfAngles)
+{
+  if (numberOfAngles == 0 || numberOfAngles > ROMER_MAX_ANGLES_PER_REQUEST) return RC_INV_UART1_LENGTH;
+  m_anglesPerRequest = numberOfAngles;
+  buildRequests();
+  return RC_OK;
+}
+
+// ----------------------------------------------------------------------------
+/// \brief     Get all angles of the last valid reply
+/// \detail    Samples are in the order of the reply, see encoder_sample_t::position.
+///            All angles of one reply carry the capture time of the reply.
+/// \warning   Does not drive the transaction engine, use getSampleCount() to detect new replies
+/// \return    Status of the last angle transaction
+/// \todo      
+///
+uint8_t Encoder::getAngleBatch(encoder_sample_t samples[], const uint8_t maxSamples, uint8_t &numberOfSamples)
+{
+  numberOfSamples = (m_batchLength < maxSamples) ? m_batchLength : maxSamples;
+  for (uint8_t i = 0; i < numberOfSamples; i++)
+  {
+    samples[i] = m_batch[i];
+  }
+  return m_angleStatus;
+}
+
+// ----------------------------------------------------------------------------
+/// \brief     Decode the reply of a B command
+/// \detail    Fills m_batch with all angles of the reply. The last angle is the current one.
+/// \warning   
+/// \return    RC_OK if reply was valid, an invalid reply is counted in the link statistics
+/// \todo      
+///
+uint8_t Encoder::decodeAngles(const uint8_t rxFrame[])
+{
+  uint8_t errorCode = RC_OK;
+  if (m_deviceAddress != ROMER_BROADCAST_ADDRESS && (rxFrame[RomerBReply::ADDRESS_FIELD] >> 4) != m_deviceAddress) errorCode = RC_INV_UART1_ADDRESS;
+
+  // Address and CRC8 are already validated by the parser
+  if (errorCode == RC_OK) errorCode = RomerBReply::check(rxFrame, ROMER_MAX_ANGLES_PER_REQUEST);
+  uint8_t numberOfAngles = RomerBReply::numberOfBlocks(rxFrame[RomerBReply::LENGTH_FIELD]);
+  if (errorCode == RC_OK && numberOfAngles == 0) errorCode = RC_INV_UART1_LENGTH;
+  if (errorCode != RC_OK)
+  {
+    countError(errorCode);
+    return errorCode;
+  }
+
+  for (uint8_t i = 0; i < numberOfAngles; i++)
+  {
+    uint8_t block = RomerBReply::blockField(i);
+    m_batch[i].rawAngle = RomerBReply::readUint32(rxFrame, block + RomerBReply::ANGLE_OFFSET);
+    m_batch[i].info     = rxFrame[block + RomerBReply::ANGLE_INFO_OFFSET];
+    m_batch[i].position = i;
+    m_batch[i].timestampUs = m_captureTimeUs;
+  }
+  m_batchLength  = numberOfAngles;
+  m_lastValidSampleMs = millis();
+  m_rawAngle     = m_batch[numberOfAngles - 1].rawAngle;
+  m_sampleCount += numberOfAngles;
+#ifdef DEBUG_VERBOSE
       Serial.print(F("Raw angle (UART1 RX): "));
-      Serial.println(rawAngle);
+      Serial.println(m_rawAngle);
 #endif
 	return RC_OK;
 }
 
 /// <summary>
 /// sendRomerBCmd: Sends Romer "B" Command (0x42) to Encoder
+/// The frame is prepared by buildRequests(), no CRC calculation per sample
 /// </summary>
 void Encoder::sendRomerBCmd()
 {
-    // First: Send CMD
-//Romer Protocol
-// | Address Field | Length | Command | Number of Angles | CRC8 
-// Supported Protocol
-// | 0xF0          | 0x03   | 0x42    | 1                | CRC8
-// 0xF0: Master to all Encoder
-// Length of the command in bytes, excluding the address and the length byte itself
-    uint8_t cmd[] = {ROMER_CMD_B_ADDRESS_TX, ROMER_CMD_B_LENGTH_TX, ROMER_CMD_B_RX, ROMER_CMD_B_NUMBER_OF_ANGLES, DEFAULT_CRC_VALUE};
+    submitTransaction(m_bRequest, sizeof(m_bRequest), RomerBReply::frameLength(m_anglesPerRequest));
+}
 
-  // The CRC8 byte is calculated from the whole command
-    cmd[ROMER_CRC_FIELD_TX] = CSV_CalcCRC8(cmd, (uint32_t)(sizeof(cmd) / sizeof(cmd[0])) - 1); // size - 1: Without crc
-    m_serialHandler->write(cmd, sizeof(cmd));
+/// <summary>
+/// Sends the B command unless the circuit breaker holds it back.
+/// A due probe first repeats the parity switch: a power cycled encoder is back in 9 bit mode.
+/// It is also back at ENCODER_UART_SPEED: after a negotiation the probes alternate between
+/// the rate of the lost link and the power-up rate.
+/// </summary>
+void Encoder::requestAngles()
+{
+    if (m_linkState == ENCODER_LINK_DOWN)
+    {
+      if ((int32_t)(millis() - m_nextProbeMs) < 0) return;
+      m_linkState = ENCODER_LINK_PROBING;
+      unsigned long probeBaudrate = (m_probeCount & 1) ? ENCODER_UART_SPEED : m_downBaudrate;
+      if (probeBaudrate != m_serialHandler->getBaudrate()) setLinkBaudrate(probeBaudrate);
+      m_probeCount++;
+      setEightBitMode();
+    }
+    sendRomerBCmd();
 }
 
 /// <summary>
-/// sendRomerGCmd: Sends Romer "G" Command (0x47) to Encoder
+/// Circuit breaker: result of an angle transaction. A valid reply (even if it does not
+/// decode) proves the link, timeouts and corrupted frames count as failures.
 /// </summary>
-void Encoder::sendRomerGCmd()
+void Encoder::updateLinkState(const uint8_t errorCode)
 {
-    uint8_t cmd[] = { ROMER_CMD_B_ADDRESS_TX, ROMER_CMD_READ_REGISTER_LENGTH_TX, ROMER_CMD_G_TX, ROMER_REGISTER_ADDRESS_LSB, ROMER_REGISTER_ADDRESS_MSB, ROMER_CMD_G_NUMBER_OF_REGISTER, DEFAULT_CRC_VALUE };
-    // The CRC8 byte is calculated from the whole command
-    cmd[ROMER_CRC_FIELD_G_COMMAND_TX] = CSV_CalcCRC8(cmd, (uint32_t)(sizeof(cmd) / sizeof(cmd[0])) - 1); // size - 1: Without crc
-    m_serialHandler->write(cmd, sizeof(cmd)/ sizeof(cmd[0]));
+    bool linkError = (errorCode == RC_INV_UART1_TIMEOUT || errorCode == RC_INV_UART1_CRC || errorCode == RC_INV_UART1_LENGTH);
+    if (!linkError)
+    {
+      if (m_linkState != ENCODER_LINK_UP)
+      {
+#ifdef DEBUG
+        Serial.println(F("Encoder link up"));
+#endif
+        m_backoffMs = BREAKER_BACKOFF_MIN_MS;
+        // A power cycle resets the baud rate and the trigger mode, see restoreConfiguration()
+        bool baudrateLost = (m_negotiatedBaudrate != 0 && m_serialHandler->getBaudrate() != m_negotiatedBaudrate);
+        if (baudrateLost || m_hardwareTrigger) m_restorePending = true;
+      }
+      m_linkState = ENCODER_LINK_UP;
+      m_consecutiveFailures = 0;
+      return;
+    }
+
+    if (m_consecutiveFailures < 0xFF) m_consecutiveFailures++;
+    if (m_linkState == ENCODER_LINK_PROBING)
+    {
+      m_backoffMs = (2 * m_backoffMs < BREAKER_BACKOFF_MAX_MS) ? 2 * m_backoffMs : BREAKER_BACKOFF_MAX_MS;
+      m_linkState   = ENCODER_LINK_DOWN;
+      m_nextProbeMs = millis() + m_backoffMs;
+    }
+    else if (m_linkState == ENCODER_LINK_UP && m_consecutiveFailures >= BREAKER_FAILURE_THRESHOLD)
+    {
+      openBreaker();
+    }
 }
 
 /// <summary>
-/// Reads a specific romer command
+/// Link down: no requests until the first probe after BREAKER_BACKOFF_MIN_MS
 /// </summary>
-/// <param name="recBuffer">Receive Buffer</param>
-/// <param name="recBufferLength">Length of the Receive Buffer</param>
-/// <returns></returns>
-uint8_t Encoder::readRomerCmd(uint8_t recBuffer[], uint8_t recBufferLength)
+void Encoder::openBreaker()
 {
-    uint8_t retries = 0;
-    while (m_serialHandler->available() <= 0)
+#ifdef DEBUG
+    Serial.println(F("Encoder link down"));
+#endif
+    m_linkState    = ENCODER_LINK_DOWN;
+    m_backoffMs    = BREAKER_BACKOFF_MIN_MS;
+    m_nextProbeMs  = millis() + m_backoffMs;
+    m_downBaudrate = m_serialHandler->getBaudrate();
+    m_probeCount   = 0;
+}
+
+/// <summary>
+/// Prepares the B command for the current device address and number of angles
+/// </summary>
+void Encoder::buildRequests()
+{
+// | Address Field | Length | Command | Number of Angles | CRC8
+// | 0xF0          | 0x03   | 0x42    | N (1 ... 8)      | CRC8
+// 0xF0: Master to all Encoder, 0xFn: Master to slave n
+    RomerBRequest::writeHeader(m_bRequest, m_deviceAddress, 0);
+    m_bRequest[RomerBRequest::NUMBER_FIELD] = m_anglesPerRequest;
+    RomerBRequest::seal(m_bRequest, 0);
+}
+
+/// <summary>
+/// sendRomerGCmd: Sends Romer "G" Command (0x47) to Encoder: read registers
+/// </summary>
+/// <param name="registerAddress">First register</param>
+/// <param name="numberOfRegisters">Number of contiguous registers, 1 ... ROMER_MAX_REGISTERS_PER_REQUEST</param>
+void Encoder::sendRomerGCmd(const uint16_t registerAddress, const uint8_t numberOfRegisters)
+{
+    uint8_t cmd[RomerGRequest::frameLength(0)];
+    RomerGRequest::writeHeader(cmd, m_deviceAddress, 0);
+    RomerGRequest::writeUint16(cmd, RomerGRequest::REGISTER_FIELD, registerAddress);
+    cmd[RomerGRequest::NUMBER_FIELD] = numberOfRegisters;
+    uint8_t length = RomerGRequest::seal(cmd, 0);
+    submitTransaction(cmd, length, RomerGReply::frameLength(numberOfRegisters));
+}
+
+/// <summary>
+/// Starts a transaction: sends the request and arms the reply deadlines.
+/// A frame not released yet and bytes of an aborted earlier reply are dropped first.
+/// </summary>
+/// <param name="cmd">Request frame</param>
+/// <param name="cmdLength">Length of the request frame</param>
+/// <param name="replyLength">Length of the expected reply frame</param>
+void Encoder::submitTransaction(const uint8_t cmd[], uint8_t cmdLength, uint8_t replyLength)
+{
+    releaseFrame();
+    while (m_serialHandler->available() > 0) m_serialHandler->read();
+
+    m_serialHandler->write(cmd, cmdLength);
+
+    m_txTimeUs         = m_serialHandler->getTxEndUs(); // write() does not wait for the transmission
+    m_lastRxTimeUs     = m_txTimeUs;
+    m_parser.reset();
+    m_rxCount          = 0;
+    m_rxExpected       = replyLength;
+    m_rxErrorCode      = RC_OK;
+    m_frameDeadlineUs  = ROMER_RESPONSE_TIMEOUT_US + 2 * m_rxExpected * m_charTimeUs; // 100 % margin on the frame time
+    m_transactionState = ROMER_TRANSACTION_WAIT_REPLY;
+}
+
+/// <summary>
+/// Feeds the bytes which are already received into the frame parser, never waits.
+/// After a rejected frame (CRC8, length) the rest of the reply is dropped until the line is
+/// quiet, so the next request does not collide with it on the half duplex bus. If all bytes
+/// of the expected reply are in, nothing follows: the transaction ends at once.
+/// Timeout if the first byte is late, if the gap between two bytes exceeds
+/// INTER_CHAR_TIMEOUT_CHARS character times or if the whole frame is late.
+/// </summary>
+/// <returns>RC_BUSY while incomplete, RC_OK when a valid reply is complete, RC_INV_UART1_CRC,
+/// RC_INV_UART1_LENGTH, RC_INV_UART1_TIMEOUT</returns>
+uint8_t Encoder::pollTransaction()
+{
+    if (m_transactionState == ROMER_TRANSACTION_IDLE) return RC_OK;
+
+    uint32_t now = micros();
+    uint32_t sinceTxUs = ((int32_t)(now - m_txTimeUs) > 0) ? now - m_txTimeUs : 0; // Request may still be on the line
+    while (m_rxErrorCode != RC_OK && m_serialHandler->available() > 0)
     {
-        if (retries > 10) return RC_INV_UART1_TIMEOUT;
-        delay(5);
-        retries++;
+        m_serialHandler->read();
+        m_rxCount++;
+        m_lastRxTimeUs = now;
+    }
+    while (m_rxErrorCode == RC_OK && m_serialHandler->available() > m_parser.getCandidateLength())
+    {
+        uint8_t errorCode = m_parser.parse();
+        if (m_rxCount == 0) m_firstRxTimeUs = now;
+        m_rxCount++;
+        m_lastRxTimeUs = now;
+
+        if (errorCode == RC_OK)
+        {
+            // The encoder latches the angle between the end of the request and the start
+            // of the reply. The first reply byte is complete one character after that start,
+            // the rest of the reply and the reading of it do not count. A late poll only
+            // makes the turnaround look longer, so the shortest one is used. The minimum is
+            // taken over windows of TURNAROUND_WINDOW replies, so it follows a turnaround that
+            // grows (encoder or bus load) instead of sticking to the shortest one ever seen.
+            uint32_t roundTripUs = micros() - m_txTimeUs;
+            if ((int32_t)roundTripUs < 0) roundTripUs = 0; // Reply before the expected end of the request
+            uint32_t firstByteUs = m_firstRxTimeUs - m_txTimeUs;
+            uint32_t turnaroundUs = ((int32_t)firstByteUs > (int32_t)m_charTimeUs) ? firstByteUs - m_charTimeUs : 0;
+            updateTurnaround(turnaroundUs);
+            recordRoundTrip(roundTripUs);
+            uint32_t minTurnaroundUs = (m_windowTurnaroundUs < m_minTurnaroundUs) ? m_windowTurnaroundUs : m_minTurnaroundUs;
+            m_captureTimeUs    = m_hardwareTrigger ? m_latchTimeUs : m_txTimeUs + minTurnaroundUs / 2;
+            m_rxFrame          = m_parser.getFrame();
+            return completeTransaction(RC_OK);
+        }
+        if (errorCode != RC_BUSY)
+        {
 #ifdef DEBUG
-        Serial.print(F("Number of retries (UART1 RX): "));
-        Serial.println(retries);
+            Serial.print(F("Invalid frame (UART1 RX): "));
+            Serial.println(errorCode);
 #endif
+            m_rxErrorCode = errorCode;
+            m_parser.reset(); // The rest of the reply is drained
+        }
+    }
+
+    bool quiet = (now - m_lastRxTimeUs) > (INTER_CHAR_TIMEOUT_CHARS * m_charTimeUs);
+    if (m_rxErrorCode != RC_OK)
+    {
+        if (quiet || m_rxCount >= m_rxExpected || sinceTxUs > m_frameDeadlineUs) return completeTransaction(m_rxErrorCode);
+        return RC_BUSY;
     }
-    m_serialHandler->readBytes(recBuffer, recBufferLength);
 
+    bool timeout = sinceTxUs > m_frameDeadlineUs;
+    if (m_rxCount == 0)
+    {
+        timeout = timeout || sinceTxUs > ROMER_RESPONSE_TIMEOUT_US;
+    }
+    else
+    {
+        timeout = timeout || quiet;
+    }
+
+    if (timeout)
+    {
 #ifdef DEBUG
-    Serial.println(F("Received bytes (UART1 RX): "));
-    for (uint8_t i = 0; i < recBufferLength; i++)
+        Serial.print(F("Timeout (UART1 RX), bytes received: "));
+        Serial.println(m_rxCount);
+#endif
+        return completeTransaction(RC_INV_UART1_TIMEOUT);
+    }
+    return RC_BUSY;
+}
+
+/// <summary>
+/// Ends the current transaction and updates the statistics
+/// </summary>
+/// <param name="errorCode">Result of the transaction</param>
+/// <returns>errorCode</returns>
+uint8_t Encoder::completeTransaction(const uint8_t errorCode)
+{
+    m_transactionState = ROMER_TRANSACTION_IDLE;
+    m_stats.transactions++;
+
+    uint32_t discardedBytes = m_parser.getDiscardedBytes();
+    if (discardedBytes != m_discardedBytes)
     {
-        Serial.print(recBuffer[i], HEX);
-        Serial.println("");
+      m_stats.resyncs++;
+      m_discardedBytes = discardedBytes;
     }
+
+    if (errorCode == RC_OK) m_stats.validFrames++;
+    else countError(errorCode);
+    return errorCode;
+}
+
+/// <summary>
+/// Counts a failed transaction by cause
+/// </summary>
+void Encoder::countError(const uint8_t errorCode)
+{
+    m_stats.errors++;
+    switch (errorCode)
+    {
+      case RC_INV_UART1_TIMEOUT: m_stats.timeouts++;      break;
+      case RC_INV_UART1_CRC:     m_stats.crcErrors++;     break;
+      case RC_INV_UART1_LENGTH:  m_stats.lengthErrors++;  break;
+      case RC_INV_UART1_COMMAND: m_stats.commandErrors++; break;
+      case RC_INV_UART1_ADDRESS: m_stats.addressErrors++; break;
+      default: break;
+    }
+}
+
+/// <summary>
+/// Round-trip of a valid frame into min / max and the histogram
+/// </summary>
+void Encoder::recordRoundTrip(const uint32_t roundTripUs)
+{
+    uint32_t bucket = roundTripUs / ENCODER_LATENCY_BUCKET_US;
+    if (bucket >= ENCODER_LATENCY_BUCKETS) bucket = ENCODER_LATENCY_BUCKETS - 1;
+    m_stats.latencyHistogram[bucket]++;
+    if (roundTripUs < m_stats.minRoundTripUs) m_stats.minRoundTripUs = roundTripUs;
+    if (roundTripUs > m_stats.maxRoundTripUs) m_stats.maxRoundTripUs = roundTripUs;
+}
+
+/// <summary>
+/// Polls the current transaction until it is complete or timed out.
+/// Only used during initialization, bounded by the transaction deadlines.
+/// </summary>
+/// <returns>RC_OK or RC_INV_UART1_TIMEOUT</returns>
+uint8_t Encoder::waitTransaction()
+{
+    uint8_t errorCode;
+    while ((errorCode = pollTransaction()) == RC_BUSY);
+    return errorCode;
+}
+
+/// <summary>
+/// Checks with one G command, if the encoder answers in 8 bit binary mode
+/// </summary>
+/// <returns>true if a valid G reply was received</returns>
+bool Encoder::probeEightBitMode()
+{
+    if (m_deviceAddress == ROMER_BROADCAST_ADDRESS)
+    {
+      // Constant frame, built by the compiler
+      typedef RomerGRequestFrame<ROMER_BROADCAST_ADDRESS, 0x0000, 1> ProbeRequest;
+      submitTransaction(ProbeRequest::data, ProbeRequest::FRAME_LENGTH, RomerGReply::frameLength(1));
+    }
+    else
+    {
+      sendRomerGCmd(0x0000, 1);
+    }
+    bool valid = (waitTransaction() == RC_OK && m_rxFrame[RomerGReply::COMMAND_FIELD] == RomerGReply::COMMAND);
+    releaseFrame();
+#ifdef DEBUG
+    if (valid) Serial.println(F("Valid command received (probeEightBitMode)"));
 #endif
-    return RC_OK;
+    return valid;
 }
 
 /// <summary>
 /// Set 8 bit mode, binary
 /// Usage: It is necessary to write in 9 bit mode with the MSB 1
 /// Trick: Write in 8 bit mode and add partiy bit (even or odd -> 1 is neccessary)
+/// The UART is switched back as soon as the last stop bit is out.
 /// </summary>
 void Encoder::setEightBitMode()
 {
+    unsigned long baudrate = m_serialHandler->getBaudrate();
     m_serialHandler->end();
-    m_serialHandler->begin(UART_SPEED, SERIAL_8O1); // odd parity
+    m_serialHandler->begin(baudrate, SERIAL_8O1); // odd parity
 
     uint8_t cmd[] = {0xFF, 0xFF, 0xAA, 0xAA};
     m_serialHandler->write(cmd, sizeof(cmd)/ sizeof(cmd[0]));
-    delay(100);
+    m_serialHandler->flush(); // Wait for the transmission, no fixed delay
     m_serialHandler->end();
-    m_serialHandler->begin(UART_SPEED, SERIAL_8N1); // Default, no parity
+    m_serialHandler->begin(baudrate, SERIAL_8N1); // Default, no parity
+}
+
+// ----------------------------------------------------------------------------
+/// \brief     Switch encoder and Serial1 to the highest working baud rate
+/// \detail    Tries the rates from ENCODER_UART_SPEED_MAX down to the current rate.
+///            Every switch is verified with BAUDRATE_VERIFY_PROBES G commands, on failure
+///            the encoder is set back. Round-trip of the start rate and the new rate are
+///            benchmarked and reported on the debug port.
+/// \warning   Blocking. Call after initialize(), before pipelined sampling starts.
+///            The encoder register is ENCODER_BAUDRATE_REGISTER (config.hpp)
+/// \return    RC_OK if the link runs at the best rate found (may be unchanged)
+/// \todo      
+///
+uint8_t Encoder::negotiateBaudrate()
+{
+  static const unsigned long BAUDRATES[] = { 921600, 460800, 230400, 115200 }; // Descending
+  uint32_t averageUs;
+  uint32_t maxUs;
+  unsigned long startBaudrate = m_serialHandler->getBaudrate();
+
+  m_negotiatedBaudrate = ENCODER_UART_SPEED_MAX; // Requested, restoreConfiguration() retries until reached once
+  if (isDegraded()) return RC_INV_UART1_TIMEOUT;
+  if (benchmarkRoundTrip(BAUDRATE_BENCHMARK_TRANSACTIONS, averageUs, maxUs) != RC_OK) return RC_INV_UART1_TIMEOUT;
+#ifdef DEBUG
+  Serial.print(F("Baudrate: ")); Serial.print(startBaudrate);
+  Serial.print(F(" round-trip avg us: ")); Serial.print(averageUs);
+  Serial.print(F(" max us: ")); Serial.println(maxUs);
+#endif
+
+  for (uint8_t i = 0; i < sizeof(BAUDRATES) / sizeof(BAUDRATES[0]); i++)
+  {
+    if (BAUDRATES[i] > ENCODER_UART_SPEED_MAX) continue;
+    if (BAUDRATES[i] <= startBaudrate) break; // Slower rates bring nothing
+
+    if (switchBaudrate(BAUDRATES[i]) != RC_OK) continue;
+
+    if (benchmarkRoundTrip(BAUDRATE_BENCHMARK_TRANSACTIONS, averageUs, maxUs) == RC_OK)
+    {
+#ifdef DEBUG
+      Serial.print(F("Baudrate: ")); Serial.print(BAUDRATES[i]);
+      Serial.print(F(" round-trip avg us: ")); Serial.print(averageUs);
+      Serial.print(F(" max us: ")); Serial.println(maxUs);
+#endif
+      m_negotiatedBaudrate = BAUDRATES[i];
+      return RC_OK;
+    }
+    switchBaudrate(startBaudrate); // Verified, but not stable under load
+  }
+  m_negotiatedBaudrate = m_serialHandler->getBaudrate();
+  return RC_OK;
+}
+
+// ----------------------------------------------------------------------------
+/// \brief     Is a restoreConfiguration() due?
+/// \detail    Set when the link comes back below the negotiated rate (a power cycled
+///            encoder is at ENCODER_UART_SPEED) or in hardware trigger mode: a power
+///            cycled encoder runs free again.
+/// \warning   
+/// \return    
+/// \todo      
+///
+bool Encoder::isRestorePending()
+{
+  return m_restorePending;
+}
+
+// ----------------------------------------------------------------------------
+/// \brief     Bring a power cycled encoder back to its configuration
+/// \detail    Negotiates the baud rate again if negotiateBaudrate() was called and the
+///            link runs at another rate than it reached, then writes the trigger mode register
+///            again in hardware trigger mode. A pending angle transaction is finished first.
+/// \warning   Blocking (negotiation, register write). Not from the timer interrupt:
+///            stop the EncoderSampler around the call.
+/// \return    RC_Type, stays pending on failure
+/// \todo      
+///
+uint8_t Encoder::restoreConfiguration()
+{
+  uint8_t errorCode = RC_OK;
+  if (isDegraded()) return RC_INV_UART1_TIMEOUT; // Down again, the next recovery decides
+  finishPendingTransaction();
+  if (m_negotiatedBaudrate != 0 && m_serialHandler->getBaudrate() != m_negotiatedBaudrate) errorCode = negotiateBaudrate();
+  if (errorCode == RC_OK && m_hardwareTrigger) errorCode = setHardwareTrigger(true);
+  m_restorePending = (errorCode != RC_OK);
+#ifdef DEBUG
+  Serial.print(F("Encoder configuration restored: "));
+  Serial.println(errorCode == RC_OK);
+#endif
+  return errorCode;
+}
+
+// ----------------------------------------------------------------------------
+/// \brief     Measure the round-trip of the B command
+/// \detail    Request sent until valid reply complete, at the current baud rate
+/// \warning   Blocking, numberOfTransactions * round-trip
+/// \return    RC_OK if all transactions were valid
+/// \todo      
+///
+uint8_t Encoder::benchmarkRoundTrip(const uint16_t numberOfTransactions, uint32_t &averageUs, uint32_t &maxUs)
+{
+  uint32_t sumUs = 0;
+  uint8_t errorCode = RC_OK;
+  maxUs = 0;
+  averageUs = 0;
+  if (numberOfTransactions == 0) return RC_OK;
+  if (isDegraded()) return RC_INV_UART1_TIMEOUT;
+
+  for (uint16_t i = 0; i < numberOfTransactions; i++)
+  {
+    uint32_t startUs = micros();
+    sendRomerBCmd();
+    uint8_t transactionErrorCode = waitTransaction();
+    if (transactionErrorCode == RC_OK) transactionErrorCode = decodeAngles(m_rxFrame);
+    releaseFrame();
+    uint32_t roundTripUs = micros() - startUs;
+
+    if (transactionErrorCode != RC_OK) errorCode = transactionErrorCode;
+    sumUs += roundTripUs;
+    if (roundTripUs > maxUs) maxUs = roundTripUs;
+  }
+  averageUs = sumUs / numberOfTransactions;
+  return errorCode;
+}
+
+/// <summary>
+/// Switches the encoder and Serial1 to a new baud rate and verifies the link.
+/// The encoder acknowledges the write at the old rate, then both sides switch.
+/// If the new rate does not work, the encoder is set back to the old rate.
+/// </summary>
+/// <param name="baudrate">New baud rate</param>
+/// <returns>RC_OK if the link works at the new rate</returns>
+uint8_t Encoder::switchBaudrate(const unsigned long baudrate)
+{
+  unsigned long oldBaudrate = m_serialHandler->getBaudrate();
+
+  uint32_t value = baudrate;
+  uint8_t errorCode = writeRegisters(ENCODER_BAUDRATE_REGISTER, 1, &value);
+  if (errorCode != RC_OK) return errorCode; // Not accepted, encoder still at the old rate
+
+  setLinkBaudrate(baudrate);
+  if (verifyLink()) return RC_OK;
+
+  // Fallback: set the encoder back (best effort at the new rate) and check the old rate
+  value = oldBaudrate;
+  writeRegisters(ENCODER_BAUDRATE_REGISTER, 1, &value);
+  setLinkBaudrate(oldBaudrate);
+  if (verifyLink()) return RC_INV_UART1_TIMEOUT;
+
+  // Encoder is lost at the new rate: set it back from there once more
+  setLinkBaudrate(baudrate);
+  writeRegisters(ENCODER_BAUDRATE_REGISTER, 1, &value);
+  setLinkBaudrate(oldBaudrate);
+#ifdef DEBUG
+  Serial.print(F("Baudrate fallback, link ok: "));
+  Serial.println(verifyLink());
+#endif
+  return RC_INV_UART1_TIMEOUT;
+}
+
+/// <summary>
+/// Reopens Serial1 with a new baud rate and adapts the character time
+/// </summary>
+void Encoder::setLinkBaudrate(const unsigned long baudrate)
+{
+  m_serialHandler->flush();
+  m_serialHandler->end();
+  m_serialHandler->begin(baudrate, SERIAL_8N1);
+  m_charTimeUs     = (UART_BITS_PER_CHAR * 1000000UL + baudrate - 1) / baudrate;
+  m_minTurnaroundUs = 0xFFFFFFFF; // Turnaround changes with the rate
+  m_windowTurnaroundUs = 0xFFFFFFFF;
+  m_turnaroundCount  = 0;
+}
+
+/// <summary>
+/// Windowed minimum of the turnaround: at the end of each window the minimum of the
+/// window replaces the one of the window before
+/// </summary>
+void Encoder::updateTurnaround(const uint32_t turnaroundUs)
+{
+  if (turnaroundUs < m_windowTurnaroundUs) m_windowTurnaroundUs = turnaroundUs;
+  if (++m_turnaroundCount < TURNAROUND_WINDOW) return;
+  m_minTurnaroundUs    = m_windowTurnaroundUs;
+  m_windowTurnaroundUs = 0xFFFFFFFF;
+  m_turnaroundCount    = 0;
+}
+
+/// <summary>
+/// Link check: BAUDRATE_VERIFY_PROBES consecutive valid G replies
+/// </summary>
+bool Encoder::verifyLink()
+{
+  for (uint8_t probe = 0; probe < BAUDRATE_VERIFY_PROBES; probe++)
+  {
+    if (!probeEightBitMode()) return false;
+  }
+  return true;
+}
+
+/// <summary>
+/// sendRomerWCmd: Sends the write register command (0x57) to the Encoder
+/// </summary>
+/// <param name="registerAddress">First register</param>
+/// <param name="numberOfRegisters">Number of contiguous registers, 1 ... ROMER_MAX_REGISTERS_PER_REQUEST</param>
+/// <param name="values">Register values</param>
+void Encoder::sendRomerWCmd(const uint16_t registerAddress, const uint8_t numberOfRegisters, const uint32_t values[])
+{
+    uint8_t cmd[RomerWRequest::frameLength(ROMER_MAX_REGISTERS_PER_REQUEST)];
+    RomerWRequest::writeHeader(cmd, m_deviceAddress, numberOfRegisters);
+    RomerWRequest::writeUint16(cmd, RomerWRequest::REGISTER_FIELD, registerAddress);
+    cmd[RomerWRequest::NUMBER_FIELD] = numberOfRegisters;
+    for (uint8_t i = 0; i < numberOfRegisters; i++)
+    {
+      RomerWRequest::writeUint32(cmd, RomerWRequest::blockField(i), values[i]);
+    }
+    uint8_t length = RomerWRequest::seal(cmd, numberOfRegisters);
+    submitTransaction(cmd, length, RomerWReply::frameLength(0));
+}
+
+// ----------------------------------------------------------------------------
+/// \brief     Read contiguous registers
+/// \detail    Up to ROMER_MAX_REGISTERS_PER_REQUEST registers per G command, larger ranges
+///            are split. Static registers (identity, resolution, configuration) are cached
+///            after the first read; a range which is completely cached costs no bus access.
+/// \warning   Blocking, bounded by the transaction deadlines. A pending angle transaction
+///            is completed first.
+/// \return    RC_Type
+/// \todo      
+///
+uint8_t Encoder::readRegisters(const uint16_t registerAddress, const uint8_t numberOfRegisters, uint32_t values[])
+{
+  bool cached = true;
+  for (uint8_t i = 0; i < numberOfRegisters && cached; i++)
+  {
+    cached = isRegisterCached(registerAddress + i);
+  }
+  if (cached)
+  {
+    for (uint8_t i = 0; i < numberOfRegisters; i++)
+    {
+      values[i] = m_registerCache[registerAddress + i - ROMER_STATIC_REGISTER_FIRST];
+    }
+    return RC_OK;
+  }
+
+  if (isDegraded()) return RC_INV_UART1_TIMEOUT;
+  finishPendingTransaction();
+
+  uint8_t done = 0;
+  while (done < numberOfRegisters)
+  {
+    uint8_t count = numberOfRegisters - done;
+    if (count > ROMER_MAX_REGISTERS_PER_REQUEST) count = ROMER_MAX_REGISTERS_PER_REQUEST;
+
+    sendRomerGCmd(registerAddress + done, count);
+    uint8_t errorCode = waitTransaction();
+    if (errorCode != RC_OK) return errorCode;
+    errorCode = RomerGReply::check(m_rxFrame, count);
+    if (errorCode == RC_OK && RomerGReply::numberOfBlocks(m_rxFrame[RomerGReply::LENGTH_FIELD]) != count) errorCode = RC_INV_UART1_LENGTH;
+    if (errorCode != RC_OK)
+    {
+      releaseFrame();
+      return errorCode;
+    }
+
+    for (uint8_t i = 0; i < count; i++)
+    {
+      uint16_t address = registerAddress + done + i;
+      values[done + i] = RomerGReply::readUint32(m_rxFrame, RomerGReply::blockField(i));
+
+      if (address >= ROMER_STATIC_REGISTER_FIRST && address < ROMER_STATIC_REGISTER_FIRST + ROMER_STATIC_REGISTER_COUNT)
+      {
+        m_registerCache[address - ROMER_STATIC_REGISTER_FIRST] = values[done + i];
+        m_registerCacheValid |= (1U << (address - ROMER_STATIC_REGISTER_FIRST));
+      }
+    }
+    releaseFrame();
+    done += count;
+  }
+  return RC_OK;
+}
+
+// ----------------------------------------------------------------------------
+/// \brief     Write contiguous registers
+/// \detail    Up to ROMER_MAX_REGISTERS_PER_REQUEST registers per command, larger ranges
+///            are split. Cached values of the written registers are invalidated.
+/// \warning   Blocking, bounded by the transaction deadlines
+/// \return    RC_OK if the encoder acknowledged all writes
+/// \todo      
+///
+uint8_t Encoder::writeRegisters(const uint16_t registerAddress, const uint8_t numberOfRegisters, const uint32_t values[])
+{
+  if (isDegraded()) return RC_INV_UART1_TIMEOUT;
+  finishPendingTransaction();
+
+  for (uint8_t i = 0; i < numberOfRegisters; i++)
+  {
+    uint16_t address = registerAddress + i;
+    if (address >= ROMER_STATIC_REGISTER_FIRST && address < ROMER_STATIC_REGISTER_FIRST + ROMER_STATIC_REGISTER_COUNT)
+    {
+      m_registerCacheValid &= ~(1U << (address - ROMER_STATIC_REGISTER_FIRST));
+    }
+  }
+
+  uint8_t done = 0;
+  while (done < numberOfRegisters)
+  {
+    uint8_t count = numberOfRegisters - done;
+    if (count > ROMER_MAX_REGISTERS_PER_REQUEST) count = ROMER_MAX_REGISTERS_PER_REQUEST;
+
+    sendRomerWCmd(registerAddress + done, count, &values[done]);
+    uint8_t errorCode = waitTransaction();
+    if (errorCode != RC_OK) return errorCode;
+    errorCode = RomerWReply::check(m_rxFrame, 0);
+    releaseFrame();
+    if (errorCode != RC_OK) return errorCode;
+    done += count;
+  }
+  return RC_OK;
+}
+
+// ----------------------------------------------------------------------------
+/// \brief     Invalidate the register cache
+/// \detail    E.g. after the encoder was power cycled
+/// \warning   
+/// \return    
+/// \todo      
+///
+void Encoder::invalidateRegisterCache()
+{
+  m_registerCacheValid = 0;
+}
+
+/// <summary>
+/// Is the register in the static range and already read?
+/// </summary>
+bool Encoder::isRegisterCached(const uint16_t registerAddress)
+{
+  if (registerAddress < ROMER_STATIC_REGISTER_FIRST || registerAddress >= ROMER_STATIC_REGISTER_FIRST + ROMER_STATIC_REGISTER_COUNT) return false;
+  return (m_registerCacheValid & (1U << (registerAddress - ROMER_STATIC_REGISTER_FIRST))) != 0;
+}
+
+/// <summary>
+/// Waits for a pending angle transaction, so its reply does not end up in a register access.
+/// The angle is decoded as usual.
+/// </summary>
+void Encoder::finishPendingTransaction()
+{
+  if (m_transactionState != ROMER_TRANSACTION_WAIT_REPLY) return;
+
+  uint8_t errorCode = waitTransaction();
+  updateLinkState(errorCode);
+  if (errorCode == RC_OK && m_rxFrame[RomerBReply::COMMAND_FIELD] == RomerBReply::COMMAND)
+  {
+    errorCode = decodeAngles(m_rxFrame);
+  }
+  releaseFrame();
+  m_angleStatus = errorCode;
+}
+
+/// <summary>
+/// The reply frame is decoded, its bytes in the RX ring are reused
+/// </summary>
+void Encoder::releaseFrame()
+{
+  m_parser.releaseFrame();
+  m_rxFrame = 0;
 }
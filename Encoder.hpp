@@ -3,66 +3,189 @@
 #include <stdint.h>
 #include "config.hpp"
 #include "SerialHandler.hpp"
+#include "RomerFrameParser.hpp"
+#include "RomerCodec.hpp"
+#include "Angle.hpp"
+
+/// \brief One angle of a B command reply
+typedef struct encoder_sample_s
+{
+  uint32_t rawAngle;   /// Raw angle 0 ... 2^32-1
+  uint8_t  info;       /// Angle info byte of the reply
+  uint8_t  position;   /// Position of the angle in the reply, 0: first
+  uint32_t timestampUs; /// Capture time (micros): midpoint of end of request and start of reply, trigger edge in hardware trigger mode
+} encoder_sample_t;
+
+static const uint8_t  ENCODER_LATENCY_BUCKETS   = 16;   /// Round-trip histogram buckets, the last one collects the rest
+static const uint16_t ENCODER_LATENCY_BUCKET_US = 250;  /// Width of one histogram bucket
+
+/// \brief Health of the encoder link since start or resetLinkStats()
+typedef struct encoder_link_stats_s
+{
+  uint32_t transactions;    /// Completed transactions (valid or not)
+  uint32_t validFrames;     /// Replies with valid address, length and CRC8
+  uint32_t errors;          /// Failed transactions, sum of the error counters below
+  uint32_t timeouts;        /// No reply, late byte or late frame
+  uint32_t crcErrors;       /// Frames rejected by the CRC8
+  uint32_t lengthErrors;    /// Invalid length field or unexpected number of angles
+  uint32_t commandErrors;   /// Reply to another command
+  uint32_t addressErrors;   /// Reply from another slave
+  uint32_t retries;         /// Requests repeated after a failure (bring-up probes, corrupted angle replies)
+  uint32_t resyncs;         /// Transactions in which the parser discarded bytes
+  uint32_t minRoundTripUs;  /// Request to complete reply, valid frames
+  uint32_t maxRoundTripUs;
+  uint32_t latencyHistogram[ENCODER_LATENCY_BUCKETS]; /// Round-trips of valid frames
+} encoder_link_stats_t;
 
 class Encoder
 {
 public:
+    static const uint8_t ROMER_MAX_ANGLES_PER_REQUEST = 8;  /// Upper limit of angles per B command
+    static const uint8_t ROMER_BROADCAST_ADDRESS      = 0;  /// Slave address 0: all slaves
+    static const uint8_t ROMER_MAX_SLAVE_ADDRESS      = 14; /// Slave addresses 1 ... 14, 15 is the master
 
     Encoder();
     uint8_t initialize(SerialHandler* serialHandler);
+    uint8_t getRawAngle(uint32_t &rawAngle);
+    uint8_t getSample(encoder_sample_t &sample);
     uint8_t getAngleDeg(float &angleDeg);
     uint8_t getAngleRad(float &angleRad);
     uint8_t getAngleGon(float &angleGon);
+    uint8_t update();
+    bool isBusy();
+    void setPipelineMode(const bool enable);
+    uint32_t getSampleCount();
+    uint8_t setAnglesPerRequest(const uint8_t numberOfAngles);
+    uint8_t getAngleBatch(encoder_sample_t samples[], const uint8_t maxSamples, uint8_t &numberOfSamples);
+    uint8_t setDeviceAddress(const uint8_t deviceAddress);
+    uint8_t getDeviceAddress();
+    void setAutoTrigger(const bool enable);
+    uint8_t trigger();
+    uint8_t setHardwareTrigger(const bool enable);
+    uint8_t readLatchedAngles(const uint32_t latchTimeUs);
+    uint32_t getTransactionCount();
+    uint32_t getErrorCount();
+    bool isDegraded();
+    bool isStale();
+    const encoder_link_stats_t& getLinkStats();
+    void resetLinkStats();
+    void printLinkStats();
+    uint8_t negotiateBaudrate();
+    bool isRestorePending();
+    uint8_t restoreConfiguration();
+    uint8_t readRegisters(const uint16_t registerAddress, const uint8_t numberOfRegisters, uint32_t values[]);
+    uint8_t writeRegisters(const uint16_t registerAddress, const uint8_t numberOfRegisters, const uint32_t values[]);
+    void invalidateRegisterCache();
+    uint8_t benchmarkRoundTrip(const uint16_t numberOfTransactions, uint32_t &averageUs, uint32_t &maxUs);
 
 private:
     SerialHandler* m_serialHandler;
-    static const uint8_t EIGHT_BIT_MODE_WAIT_TIME_MS = 1;
-    static const uint8_t NUMBER_OF_RETRIES = 100;
+    static const uint32_t ENCODER_POWER_UP_TIMEOUT_MS = 5000; /// Max. time until the encoder must answer after reset
+    static const uint8_t PROBES_PER_MODE_SWITCH       = 4;    /// G command probes after one parity switch
+    static const uint8_t BAUDRATE_VERIFY_PROBES       = 8;    /// Consecutive valid G replies to accept a new baud rate
+    static const uint16_t BAUDRATE_BENCHMARK_TRANSACTIONS = 100; /// B commands per baud rate benchmark
+
+    // Circuit breaker: no bus traffic while the encoder is gone, probes with exponential backoff
+    static const uint8_t  BREAKER_FAILURE_THRESHOLD   = 5;    /// Consecutive failed angle transactions until the link is down
+    static const uint32_t BREAKER_BACKOFF_MIN_MS      = 50;   /// First probe after the link went down
+    static const uint32_t BREAKER_BACKOFF_MAX_MS      = 2000; /// Longest time between two probes
+    static const uint32_t STALE_SAMPLE_MS             = 100;  /// A sample older than this is stale
+
+    // Transaction engine timing
+    static const uint32_t ROMER_RESPONSE_TIMEOUT_US   = 5000; /// Max. time from end of request to first reply byte
+    static const uint8_t  INTER_CHAR_TIMEOUT_CHARS    = 4;    /// Max. gap between two reply bytes in character times
+    static const uint8_t  UART_BITS_PER_CHAR          = 10;   /// Start + 8 data + stop bit (8N1)
+    static const uint8_t  ANGLE_RETRIES               = 1;    /// B commands repeated at once after a corrupted reply
+    static const uint8_t  TURNAROUND_WINDOW           = 64;   /// Replies per turnaround minimum, a longer turnaround is learned after two windows
     
-    //Romer Protocol RX
-    // | Address Field | Length | Command | Angle LSB | Angle | Angle | Angle MSB | CRC
-    static const uint8_t ROMER_ADDRESS_FIELD_RX       = 0;
-    static const uint8_t ROMER_LENGTH_FIELD_RX        = 1;
-    static const uint8_t ROMER_COMMAND_FIELD_RX       = 2;
-    static const uint8_t ROMER_ANGLE_INFO_FIELD_RX    = 3;
-    static const uint8_t ROMER_ANGLE1_LSB_FIELD_RX    = 4;
-    static const uint8_t ROMER_ANGLE2_FIELD_RX        = 5;
-    static const uint8_t ROMER_ANGLE3_FIELD_RX        = 6;
-    static const uint8_t ROMER_ANGLE4_MSB_FIELD_RX    = 7;
-    static const uint8_t ROMER_CRC_FIELD_RX           = 8;
-
-    static const uint8_t ROMER_CMD_B_ADDRESS_FIELD_RX = 0x1F;
-    static const uint8_t ROMER_CMD_B_LENGTH_RX        = 0x07;
-    static const uint8_t ROMER_CMD_B_RX               = 0x42;
-
-    //Romer Protocol TX
-    // | Address Field | Length | Command | Number of Angles | CRC8 
-    static const uint8_t ROMER_ADDRESS_FIELD_TX       = 0;
-    static const uint8_t ROMER_LENGTH_FIELD_TX        = 1;
-    static const uint8_t ROMER_COMMAND_FIELD_TX       = 2;
-    static const uint8_t ROMER_NUMBER_FIELD_TX        = 3;
-    static const uint8_t ROMER_CRC_FIELD_TX           = 4;
-
-    static const uint8_t ROMER_CMD_B_LENGTH_TX        = 0x03;
-    static const uint8_t ROMER_CMD_B_ADDRESS_TX       = 0xF0; // 0xF0: Master (F) sends to all (0) slaves
-    static const uint8_t ROMER_CMD_B_NUMBER_OF_ANGLES = 1; // Number of angles to send:
-    static const uint8_t DEFAULT_CRC_VALUE            = 0xFF;
-
-    static const uint8_t recBufferLength = 9;
-
-    static const uint8_t ROMER_CMD_READ_REGISTER_LENGTH_TX = 0x05;
-    static const uint8_t ROMER_CMD_G_TX = 0x47;
-    static const uint8_t ROMER_REGISTER_ADDRESS_LSB = 0x00;
-    static const uint8_t ROMER_REGISTER_ADDRESS_MSB = 0x00;
-    static const uint8_t ROMER_CMD_G_NUMBER_OF_REGISTER = 0x01;
-    static const uint8_t ROMER_CRC_FIELD_G_COMMAND_TX = 6;
+    // Frame layouts: see RomerCodec.hpp
+    static const uint8_t ROMER_MAX_REGISTERS_PER_REQUEST = 8; /// Registers per G / W command, limited by the frame length
+
+    // Register cache: identity, resolution and configuration do not change at runtime
+    static const uint16_t ROMER_STATIC_REGISTER_FIRST = 0x0000;
+    static const uint8_t  ROMER_STATIC_REGISTER_COUNT = 16;
+
+    /// \brief States of the circuit breaker
+    typedef enum encoder_link_state_e
+    {
+      ENCODER_LINK_UP,        /// Normal operation
+      ENCODER_LINK_DOWN,      /// No transactions until the next probe is due
+      ENCODER_LINK_PROBING,   /// One probe transaction on the bus
+    } encoder_link_state_t;
+
+    /// \brief States of the transaction engine
+    typedef enum romer_transaction_state_e
+    {
+      ROMER_TRANSACTION_IDLE,         /// No request on the bus
+      ROMER_TRANSACTION_WAIT_REPLY,   /// Request sent, collecting reply bytes
+    } romer_transaction_state_t;
 
     uint8_t m_initStatus; /// Init complete?
     uint32_t m_rawAngle;  /// Raw angle 0 ... 2^32-1
-    
-    uint8_t getAngle(uint32_t &rawAngle);
+    uint8_t m_angleStatus; /// Result of the last completed angle transaction
+    uint32_t m_sampleCount; /// Number of valid samples since start
+    uint8_t m_anglesPerRequest;                                /// Angles requested with one B command
+    encoder_sample_t m_batch[ROMER_MAX_ANGLES_PER_REQUEST];   /// Angles of the last valid reply
+    uint8_t m_batchLength;                                     /// Number of angles in m_batch
+    bool m_pipelineMode;   /// Trigger the next sample as soon as a reply is in
+    bool m_autoTrigger;    /// Encoder triggers itself. Off if an EncoderBus schedules the triggers
+    bool m_hardwareTrigger; /// Encoder latches on the trigger input, B commands read the latched angle
+    uint32_t m_latchTimeUs; /// Time of the trigger edge of the pending readout
+    uint8_t m_deviceAddress;        /// Slave address on the RS-485 bus, 0: broadcast
+    encoder_link_stats_t m_stats;   /// Link health counters and round-trip histogram
+    encoder_link_state_t m_linkState;   /// Circuit breaker
+    uint8_t  m_consecutiveFailures;     /// Failed angle transactions in a row
+    uint32_t m_backoffMs;               /// Time from a failed probe to the next one
+    uint32_t m_nextProbeMs;             /// millis() of the next probe
+    uint32_t m_lastValidSampleMs;       /// millis() of the last valid angle
+    unsigned long m_downBaudrate;       /// Link rate when the link went down
+    uint8_t  m_probeCount;              /// Probes since the link went down, every other one at ENCODER_UART_SPEED
+    unsigned long m_negotiatedBaudrate; /// Rate reached by negotiateBaudrate(), 0: never called
+    bool     m_restorePending;          /// Link is back, baud rate or trigger mode may be lost: restoreConfiguration()
+    uint32_t m_discardedBytes;      /// Parser discarded bytes at the end of the last transaction
+
+    romer_transaction_state_t m_transactionState; /// Transaction engine state
+    RomerFrameParser m_parser;                    /// Reply frame parser
+    const uint8_t* m_rxFrame;                     /// Valid reply of the last transaction, view into the RX ring until releaseFrame()
+    uint8_t  m_rxCount;                           /// Bytes received so far
+    uint8_t  m_rxExpected;                        /// Length of the expected reply
+    uint8_t  m_rxErrorCode;                       /// Frame rejected, rest of the reply is drained until the line is quiet
+    uint8_t  m_angleRetries;                      /// Retries of the current B command
+    uint32_t m_charTimeUs;                        /// Duration of one character on the link
+    uint32_t m_txTimeUs;                          /// Expected end of the request on the line
+    uint32_t m_lastRxTimeUs;                      /// Time of the last received byte
+    uint32_t m_firstRxTimeUs;                     /// Time the first reply byte was seen
+    uint32_t m_frameDeadlineUs;                   /// Max. duration of the whole transaction
+    uint32_t m_captureTimeUs;                     /// Midpoint of end of request and start of reply of the last valid frame
+    uint32_t m_minTurnaroundUs;                   /// Shortest time from end of request to start of reply in the last window, not inflated by late polling
+    uint32_t m_windowTurnaroundUs;                /// Shortest turnaround in the current window
+    uint8_t  m_turnaroundCount;                   /// Replies in the current window
+
+    uint32_t m_registerCache[ROMER_STATIC_REGISTER_COUNT]; /// Values of the static registers
+    uint16_t m_registerCacheValid;                         /// Bit n: m_registerCache[n] is valid
+    uint8_t m_bRequest[RomerBRequest::frameLength(0)];     /// B command for m_deviceAddress and m_anglesPerRequest
+
     void sendRomerBCmd();
-    void sendRomerGCmd();
-    uint8_t readRomerCmd(uint8_t recBuffer[], uint8_t recBufferLength);
+    void requestAngles();
+    void updateLinkState(const uint8_t errorCode);
+    void openBreaker();
+    void buildRequests();
+    void sendRomerGCmd(const uint16_t registerAddress, const uint8_t numberOfRegisters);
+    void submitTransaction(const uint8_t cmd[], uint8_t cmdLength, uint8_t replyLength);
+    uint8_t pollTransaction();
+    uint8_t completeTransaction(const uint8_t errorCode);
+    void countError(const uint8_t errorCode);
+    void recordRoundTrip(const uint32_t roundTripUs);
+    uint8_t waitTransaction();
+    uint8_t decodeAngles(const uint8_t rxFrame[]);
     void setEightBitMode();
+    bool probeEightBitMode();
+    void sendRomerWCmd(const uint16_t registerAddress, const uint8_t numberOfRegisters, const uint32_t values[]);
+    void finishPendingTransaction();
+    void releaseFrame();
+    bool isRegisterCached(const uint16_t registerAddress);
+    uint8_t switchBaudrate(const unsigned long baudrate);
+    void setLinkBaudrate(const unsigned long baudrate);
+    void updateTurnaround(const uint32_t turnaroundUs);
+    bool verifyLink();
 };
@@ -0,0 +1,150 @@
+// ****************************************************************************
+/// \file      EncoderBus.cpp
+///
+/// \brief     Several HA40+ Encoders on one RS-485 segment
+///
+/// \details   Schedules the angle requests of several encoders on one bus.
+///            Only one transaction is on the bus at a time. As soon as a reply
+///            is in, the next encoder is triggered. The order is a smooth weighted
+///            round-robin: an encoder with priority 2 is polled twice as often as
+///            one with priority 1, and the polls are interleaved.
+///            Each Encoder keeps its own state, samples and statistics.
+///
+/// \author    Christoph Capiaghi
+///
+/// \version   0.1
+///
+/// \date      20221017
+/// 
+/// \copyright Licensed under the Apache License, Version 2.0 (the "License");
+/// you may not use this file except in compliance with the License.
+/// You may obtain a copy of the License at
+/// http://www.apache.org/licenses/LICENSE-2.0
+///
+/// \pre       
+///
+/// \bug       
+///
+/// \warning   
+///
+/// \todo     
+///
+
+#include <arduino.h>
+#include "EncoderBus.hpp"
+#include "config.hpp"
+
+EncoderBus::EncoderBus() : m_numberOfEncoders(0),
+  m_totalPriority(0),
+  m_activeEncoder(-1)
+{
+
+}
+
+// ----------------------------------------------------------------------------
+/// \brief     Add an encoder to the bus
+/// \detail    The encoder is triggered by the bus only
+/// \warning   Call before initialize()
+/// \return    RC_Type
+/// \todo      
+///
+uint8_t EncoderBus::addEncoder(Encoder* encoder, const uint8_t deviceAddress, const uint8_t priority)
+{
+  if (m_numberOfEncoders >= MAX_NUMBER_OF_ENCODERS) return RC_INV_UART1_ADDRESS;
+  if (deviceAddress == Encoder::ROMER_BROADCAST_ADDRESS) return RC_INV_UART1_ADDRESS; // Replies would collide
+
+  uint8_t errorCode = encoder->setDeviceAddress(deviceAddress);
+  if (errorCode != RC_OK) return errorCode;
+
+  encoder->setAutoTrigger(false);
+  encoder->setPipelineMode(false);
+
+  m_encoders[m_numberOfEncoders]  = encoder;
+  m_priority[m_numberOfEncoders]  = (priority > 0) ? priority : 1;
+  m_credit[m_numberOfEncoders]    = 0;
+  m_pollCount[m_numberOfEncoders] = 0;
+  m_totalPriority += m_priority[m_numberOfEncoders];
+  m_numberOfEncoders++;
+  return RC_OK;
+}
+
+// ----------------------------------------------------------------------------
+/// \brief     Initialize all encoders
+/// \detail    
+/// \warning   Blocking, see Encoder::initialize()
+/// \return    RC_Type of the first encoder which failed
+/// \todo      
+///
+uint8_t EncoderBus::initialize(SerialHandler* serialHandler)
+{
+  uint8_t errorCode = RC_OK;
+  for (uint8_t i = 0; i < m_numberOfEncoders; i++)
+  {
+    uint8_t encoderErrorCode = m_encoders[i]->initialize(serialHandler);
+#ifdef DEBUG
+    Serial.print(F("EncoderBus init, address: "));
+    Serial.print(m_encoders[i]->getDeviceAddress());
+    Serial.print(F(" status: "));
+    Serial.println(encoderErrorCode);
+#endif
+    if (errorCode == RC_OK) errorCode = encoderErrorCode;
+  }
+  return errorCode;
+}
+
+// ----------------------------------------------------------------------------
+/// \brief     Drive the bus
+/// \detail    Polls the active transaction. If the bus is free, the next encoder is triggered.
+/// \warning   Call as often as possible, never blocks
+/// \return    
+/// \todo      
+///
+void EncoderBus::update()
+{
+  if (m_numberOfEncoders == 0) return;
+
+  if (m_activeEncoder >= 0)
+  {
+    if (m_encoders[m_activeEncoder]->update() == RC_BUSY) return;
+    m_activeEncoder = -1;
+  }
+
+  uint8_t next = selectNextEncoder();
+  if (m_encoders[next]->trigger() == RC_OK)
+  {
+    m_activeEncoder = next;
+    m_pollCount[next]++;
+  }
+}
+
+uint8_t EncoderBus::getNumberOfEncoders()
+{
+  return m_numberOfEncoders;
+}
+
+Encoder* EncoderBus::getEncoder(const uint8_t index)
+{
+  return (index < m_numberOfEncoders) ? m_encoders[index] : 0;
+}
+
+uint32_t EncoderBus::getPollCount(const uint8_t index)
+{
+  return (index < m_numberOfEncoders) ? m_pollCount[index] : 0;
+}
+
+/// <summary>
+/// Smooth weighted round-robin: every encoder earns its priority as credit,
+/// the one with the highest credit is polled and pays the sum of all priorities.
+/// </summary>
+/// <returns>Index of the next encoder</returns>
+uint8_t EncoderBus::selectNextEncoder()
+{
+  uint8_t selected = 0;
+  for (uint8_t i = 0; i < m_numberOfEncoders; i++)
+  {
+    m_credit[i] += m_priority[i];
+    if (m_credit[i] > m_credit[selected]) selected = i;
+  }
+  m_credit[selected] -= m_totalPriority;
+  return selected;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <stdint.h>
+#include "config.hpp"
+#include "Encoder.hpp"
+#include "SerialHandler.hpp"
+
+class EncoderBus
+{
+public:
+
+    EncoderBus();
+    uint8_t addEncoder(Encoder* encoder, const uint8_t deviceAddress, const uint8_t priority);
+    uint8_t initialize(SerialHandler* serialHandler);
+    void update();
+    uint8_t getNumberOfEncoders();
+    Encoder* getEncoder(const uint8_t index);
+    uint32_t getPollCount(const uint8_t index);
+
+    static const uint8_t MAX_NUMBER_OF_ENCODERS = 8;   /// Encoders on one RS-485 segment
+
+private:
+    Encoder* m_encoders[MAX_NUMBER_OF_ENCODERS];       /// Encoders, one per slave address
+    uint8_t  m_priority[MAX_NUMBER_OF_ENCODERS];       /// Weight: share of the bus, 1 ... 255
+    int16_t  m_credit[MAX_NUMBER_OF_ENCODERS];         /// Smooth weighted round-robin credit
+    uint32_t m_pollCount[MAX_NUMBER_OF_ENCODERS];      /// Requests sent per encoder
+    uint8_t  m_numberOfEncoders;
+    uint16_t m_totalPriority;                          /// Sum of all weights
+    int8_t   m_activeEncoder;                          /// Encoder owning the bus, -1: bus idle
+
+    uint8_t selectNextEncoder();
+};
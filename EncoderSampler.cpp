@@ -0,0 +1,276 @@
+// ****************************************************************************
+/// \file      EncoderSampler.cpp
+///
+/// \brief     Timer driven encoder sampling
+///
+/// \details   A hardware timer (TC3) runs the Romer transaction state machine of
+///            the Encoder outside loop(): every period the pending reply is polled
+///            and the next B command is triggered. Every decoded sample is pushed
+///            into a wait-free SPSC queue. The loop drains all samples once per
+///            frame, so the sample rate no longer depends on the frame rate.
+///            Without SAMD51 (host simulation) no timer is started, the caller
+///            calls onTimer() itself.
+///            Hardware trigger mode: the tick sends a pulse on the trigger pin when
+///            the TriggerScheduler says so and reads the latched angle. The samples
+///            carry the edge time, not an estimate from the bus timing.
+///
+/// \author    Christoph Capiaghi
+///
+/// \version   0.1
+///
+/// \date      20221017
+///
+/// \copyright Licensed under the Apache License, Version 2.0 (the "License");
+/// you may not use this file except in compliance with the License.
+/// You may obtain a copy of the License at
+/// http://www.apache.org/licenses/LICENSE-2.0
+///
+/// \pre
+///
+/// \bug
+///
+/// \warning   While the sampler runs, the Encoder belongs to the interrupt:
+///            no other Encoder call from loop() except read-only getters.
+///            Turn off DEBUG output of the Encoder, it must not print from
+///            the interrupt.
+///
+/// \todo
+///
+
+#include <arduino.h>
+#include "EncoderSampler.hpp"
+
+#if defined(__SAMD51__)
+static const uint32_t TIMER_CLOCK_HZ = 48000000UL / 16;   /// GCLK1 (48 MHz) / prescaler
+static const uint8_t  TIMER_IRQ_PRIORITY = 3;             /// Below SERCOM (Serial1), its TX interrupt must preempt
+#endif
+
+static EncoderSampler* s_sampler = 0;                     /// Instance of the TC3 interrupt
+
+EncoderSampler::EncoderSampler() : m_encoder(0),
+  m_periodUs(1000),
+  m_lastSampleCount(0),
+  m_droppedCount(0),
+  m_tickCount(0),
+  m_running(false),
+  m_triggerPin(NO_TRIGGER_PIN),
+  m_scheduler()
+{
+
+}
+
+// ----------------------------------------------------------------------------
+/// \brief     Initialize the sampler
+/// \detail    Configures TC3 for periodUs, not started yet
+/// \warning   Call after Encoder::initialize() and all register accesses
+/// \return    RC_Type
+/// \todo
+///
+uint8_t EncoderSampler::initialize(Encoder* encoder, const uint32_t periodUs)
+{
+  if (encoder == 0 || periodUs < MIN_PERIOD_US || periodUs > MAX_PERIOD_US) return RC_INV_PARAM;
+
+  m_encoder         = encoder;
+  m_periodUs        = periodUs;
+  m_lastSampleCount = m_encoder->getSampleCount();
+  s_sampler         = this;
+
+#if defined(__SAMD51__)
+  GCLK->PCHCTRL[TC3_GCLK_ID].reg = GCLK_PCHCTRL_GEN_GCLK1 | GCLK_PCHCTRL_CHEN;
+  while ((GCLK->PCHCTRL[TC3_GCLK_ID].reg & GCLK_PCHCTRL_CHEN) == 0);
+  MCLK->APBBMASK.reg |= MCLK_APBBMASK_TC3;
+
+  TC3->COUNT16.CTRLA.reg = TC_CTRLA_SWRST;
+  while (TC3->COUNT16.SYNCBUSY.bit.SWRST);
+  TC3->COUNT16.CTRLA.reg = TC_CTRLA_MODE_COUNT16 | TC_CTRLA_PRESCALER_DIV16;
+  TC3->COUNT16.WAVE.reg  = TC_WAVE_WAVEGEN_MFRQ;                   // Top = CC0
+  TC3->COUNT16.CC[0].reg = (uint16_t)(TIMER_CLOCK_HZ / 1000000UL * m_periodUs - 1);
+  while (TC3->COUNT16.SYNCBUSY.bit.CC0);
+  TC3->COUNT16.INTENSET.reg = TC_INTENSET_MC0;
+
+  NVIC_SetPriority(TC3_IRQn, TIMER_IRQ_PRIORITY);
+  NVIC_ClearPendingIRQ(TC3_IRQn);
+  NVIC_EnableIRQ(TC3_IRQn);
+#endif
+  return RC_OK;
+}
+
+// ----------------------------------------------------------------------------
+/// \brief     Start sampling
+/// \detail
+/// \warning
+/// \return
+/// \todo
+///
+void EncoderSampler::start()
+{
+  if (m_encoder == 0) return;
+  m_running = true;
+#if defined(__SAMD51__)
+  TC3->COUNT16.CTRLA.bit.ENABLE = 1;
+  while (TC3->COUNT16.SYNCBUSY.bit.ENABLE);
+#endif
+}
+
+// ----------------------------------------------------------------------------
+/// \brief     Stop sampling
+/// \detail    The Encoder belongs to loop() again when this returns.
+///            A pending transaction is not aborted.
+/// \warning
+/// \return
+/// \todo
+///
+void EncoderSampler::stop()
+{
+#if defined(__SAMD51__)
+  TC3->COUNT16.CTRLA.bit.ENABLE = 0;
+  while (TC3->COUNT16.SYNCBUSY.bit.ENABLE);
+#endif
+  m_running = false;
+}
+
+// ----------------------------------------------------------------------------
+/// \brief     Sample on hardware trigger pulses
+/// \detail    Switches the encoder to its trigger input and schedules a pulse every
+///            periodUs. Auto trigger and pipeline mode of the Encoder are turned off,
+///            every readout belongs to one pulse. A pulse whose readout would collide
+///            with the last one is skipped and counted.
+/// \warning   Call after initialize(), before start(). Blocking (register write).
+///            periodUs should be a multiple of the timer period.
+/// \return    RC_Type
+/// \todo
+///
+uint8_t EncoderSampler::setHardwareTrigger(const uint8_t triggerPin, const uint32_t periodUs)
+{
+  if (m_encoder == 0 || m_running) return RC_INV_PARAM;
+  uint8_t errorCode = m_scheduler.initialize(periodUs, micros());
+  if (errorCode != RC_OK) return errorCode;
+
+  pinMode(triggerPin, OUTPUT);
+  digitalWrite(triggerPin, LOW);
+  errorCode = m_encoder->setHardwareTrigger(true);
+  if (errorCode != RC_OK) return errorCode;
+
+  m_encoder->setAutoTrigger(false);
+  m_encoder->setPipelineMode(false);
+  m_triggerPin = triggerPin;
+  return RC_OK;
+}
+
+// ----------------------------------------------------------------------------
+/// \brief     Phase-lock the trigger pulses to the display frame
+/// \detail    See TriggerScheduler::lockToFrame()
+/// \warning   loop() only
+/// \return
+/// \todo
+///
+void EncoderSampler::lockToFrame(const uint32_t frameStartUs, const uint32_t leadUs)
+{
+  if (m_triggerPin != NO_TRIGGER_PIN) m_scheduler.lockToFrame(frameStartUs, leadUs);
+}
+
+// ----------------------------------------------------------------------------
+/// \brief     Get the pulse schedule
+/// \detail    Read-only use from loop(): pulse, skip and phase statistics
+/// \warning
+/// \return
+/// \todo
+///
+TriggerScheduler& EncoderSampler::getTriggerScheduler()
+{
+  return m_scheduler;
+}
+
+bool EncoderSampler::isRunning()
+{
+  return m_running;
+}
+
+// ----------------------------------------------------------------------------
+/// \brief     Timer tick: drive the encoder, queue new samples
+/// \detail    Producer side of the queue. Never waits: the transaction state machine
+///            only polls, a full queue drops the sample and counts it.
+/// \warning   Interrupt context (TC3)
+/// \return
+/// \todo
+///
+void EncoderSampler::onTimer()
+{
+  if (!m_running) return;
+  m_tickCount++;
+
+  m_encoder->update();
+  if (m_triggerPin != NO_TRIGGER_PIN) sendTriggerPulse();
+  else m_encoder->trigger(); // RC_BUSY while pending (pipeline mode), gated by the circuit breaker
+
+  uint32_t sampleCount = m_encoder->getSampleCount();
+  if (sampleCount == m_lastSampleCount) return;
+  m_lastSampleCount = sampleCount;
+
+  encoder_sample_t samples[Encoder::ROMER_MAX_ANGLES_PER_REQUEST];
+  uint8_t numberOfSamples = 0;
+  m_encoder->getAngleBatch(samples, Encoder::ROMER_MAX_ANGLES_PER_REQUEST, numberOfSamples);
+  for (uint8_t i = 0; i < numberOfSamples; i++)
+  {
+    if (!m_queue.push(samples[i])) m_droppedCount++;
+  }
+}
+
+// ----------------------------------------------------------------------------
+/// \brief     Take the oldest sample
+/// \detail    Consumer side of the queue, loop() only
+/// \warning
+/// \return    false if no sample is queued
+/// \todo
+///
+bool EncoderSampler::pop(encoder_sample_t& sample)
+{
+  return m_queue.pop(sample);
+}
+
+// ----------------------------------------------------------------------------
+/// \brief     Get number of lost samples
+/// \detail    Queue full: loop() did not drain for QUEUE_SIZE samples
+/// \warning
+/// \return
+/// \todo
+///
+uint32_t EncoderSampler::getDroppedCount()
+{
+  return m_droppedCount;
+}
+
+uint32_t EncoderSampler::getTickCount()
+{
+  return m_tickCount;
+}
+
+/// <summary>
+/// Hardware trigger: pulse on the trigger pin if due, then read the latched angle.
+/// The edge time is taken between the two pin writes, the pulse is only a few microseconds.
+/// </summary>
+void EncoderSampler::sendTriggerPulse()
+{
+  if (!m_scheduler.isPulseDue(micros())) return;
+  if (m_encoder->isBusy())
+  {
+    m_scheduler.skipPulse(); // Latching now would overwrite the angle still being read
+    return;
+  }
+  digitalWrite(m_triggerPin, HIGH);
+  uint32_t edgeUs = micros();
+  delayMicroseconds(TRIGGER_PULSE_US);
+  digitalWrite(m_triggerPin, LOW);
+  m_encoder->readLatchedAngles(m_scheduler.firePulse(edgeUs));
+}
+
+#if defined(__SAMD51__)
+// ----------------------------------------------------------------------------
+/// \brief     TC3 interrupt
+///
+void TC3_Handler()
+{
+  TC3->COUNT16.INTFLAG.reg = TC_INTFLAG_MC0;
+  if (s_sampler) s_sampler->onTimer();
+}
+#endif
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <stdint.h>
+#include "config.hpp"
+#include "Encoder.hpp"
+#include "SpscQueue.hpp"
+#include "TriggerScheduler.hpp"
+
+class EncoderSampler
+{
+public:
+    static const uint16_t QUEUE_SIZE        = 64;      /// Samples, > 2 frames at 1 kHz and 45 FPS
+    static const uint32_t MIN_PERIOD_US     = 100;
+    static const uint32_t MAX_PERIOD_US     = 20000;   /// 16 bit timer at 3 MHz
+    static const uint8_t  TRIGGER_PULSE_US  = 2;       /// Width of the trigger pulse. Check against the HA40+ manual
+    static const uint8_t  NO_TRIGGER_PIN    = 0xFF;
+
+    EncoderSampler();
+    uint8_t initialize(Encoder* encoder, const uint32_t periodUs);
+    void start();
+    void stop();
+    uint8_t setHardwareTrigger(const uint8_t triggerPin, const uint32_t periodUs);
+    void lockToFrame(const uint32_t frameStartUs, const uint32_t leadUs);
+    TriggerScheduler& getTriggerScheduler();
+    bool isRunning();
+    void onTimer();
+    bool pop(encoder_sample_t& sample);
+    uint32_t getDroppedCount();
+    uint32_t getTickCount();
+
+private:
+    Encoder* m_encoder;
+    uint32_t m_periodUs;
+    SpscQueue<encoder_sample_t, QUEUE_SIZE> m_queue;   /// Timer interrupt -> loop
+    uint32_t m_lastSampleCount;                        /// Sample count of the encoder at the last push
+    volatile uint32_t m_droppedCount;                  /// Samples lost, queue full
+    volatile uint32_t m_tickCount;                     /// Timer interrupts
+    volatile bool m_running;
+    uint8_t m_triggerPin;                              /// Hardware trigger output, NO_TRIGGER_PIN: encoder triggered by B commands
+    TriggerScheduler m_scheduler;                      /// Pulse times of the hardware trigger
+
+    void sendTriggerPulse();
+};
@@ -0,0 +1,206 @@
+// ****************************************************************************
+/// \file      RomerCodec.hpp
+///
+/// \brief     Romer protocol frame layouts
+///
+/// \details   Each command and reply is a type with its field offsets, lengths and
+///            command byte known at compile time. Encoding and decoding use the same
+///            description. Constant frames (fixed address and data) are built by
+///            RomerFrame, including the CRC8, by the compiler and live in flash.
+///
+///            | Address Field | Length | Command | Fixed Data | Block 1 | ... | Block N | CRC8
+///            Length: number of bytes after the length field, including the CRC
+///
+/// \author    Christoph Capiaghi
+///
+/// \version   0.1
+///
+/// \date      20221017
+///
+/// \copyright Licensed under the Apache License, Version 2.0 (the "License");
+/// you may not use this file except in compliance with the License.
+/// You may obtain a copy of the License at
+/// http://www.apache.org/licenses/LICENSE-2.0
+///
+/// \pre
+///
+/// \bug
+///
+/// \warning   Header only, C++11: constexpr functions are single return statements
+///
+/// \todo
+///
+
+// Prevent recursive inclusion
+#pragma once
+
+#include <stdint.h>
+#include "config.hpp"
+#include "Crc8.hpp"
+
+static const uint8_t ROMER_MASTER_NIBBLE_TX = 0xF0; /// Master (F) sends, low nibble: slave address, 0: all slaves
+
+// ----------------------------------------------------------------------------
+/// \brief     CRC8 of a byte list, evaluated by the compiler
+///
+template<uint8_t Crc, uint8_t... Bytes> struct RomerCrc8;
+
+template<uint8_t Crc> struct RomerCrc8<Crc>
+{
+  static constexpr uint8_t value = Crc;
+};
+
+template<uint8_t Crc, uint8_t First, uint8_t... Rest> struct RomerCrc8<Crc, First, Rest...>
+{
+  static constexpr uint8_t value = RomerCrc8<crc8Byte(Crc, First), Rest...>::value;
+};
+
+// ----------------------------------------------------------------------------
+/// \brief     Constant frame: the bytes before the CRC are given, the CRC is appended
+/// \detail    data[] is a constexpr array, no CRC calculation at runtime
+///
+template<uint8_t... Bytes> struct RomerFrame
+{
+  static constexpr uint8_t CRC          = RomerCrc8<0, Bytes...>::value;
+  static constexpr uint8_t FRAME_LENGTH = sizeof...(Bytes) + 1;
+  static constexpr uint8_t data[FRAME_LENGTH] = { Bytes..., CRC };
+};
+
+template<uint8_t... Bytes> constexpr uint8_t RomerFrame<Bytes...>::data[RomerFrame<Bytes...>::FRAME_LENGTH];
+
+// ----------------------------------------------------------------------------
+/// \brief     Layout of a command or reply
+/// \tparam    Command       Command byte
+/// \tparam    FixedLength   Data bytes in front of the blocks
+/// \tparam    BlockLength   Bytes per repeated block (angle, register value), 0: no blocks
+///
+template<uint8_t Command, uint8_t FixedLength, uint8_t BlockLength> struct RomerLayout
+{
+  static constexpr uint8_t COMMAND        = Command;
+  static constexpr uint8_t ADDRESS_FIELD  = 0;
+  static constexpr uint8_t LENGTH_FIELD   = 1;
+  static constexpr uint8_t COMMAND_FIELD  = 2;
+  static constexpr uint8_t DATA_FIELD     = 3;                          /// First fixed data byte
+  static constexpr uint8_t BLOCK_FIELD    = DATA_FIELD + FixedLength;   /// First block
+  static constexpr uint8_t BLOCK_LENGTH   = BlockLength;
+  static constexpr uint8_t HEADER_LENGTH  = 2;                          /// Address + Length, not counted by the length field
+
+  /// \brief Complete frame with n blocks
+  static constexpr uint8_t frameLength(const uint8_t n) { return BLOCK_FIELD + BlockLength * n + 1; }
+  /// \brief Value of the length field with n blocks
+  static constexpr uint8_t lengthValue(const uint8_t n) { return frameLength(n) - HEADER_LENGTH; }
+  /// \brief Position of the CRC with n blocks
+  static constexpr uint8_t crcField(const uint8_t n) { return frameLength(n) - 1; }
+  /// \brief Position of block i
+  static constexpr uint8_t blockField(const uint8_t i) { return BLOCK_FIELD + BlockLength * i; }
+  /// \brief Number of blocks for a length field value, no validation
+  static constexpr uint8_t numberOfBlocks(const uint8_t length) { return (length - lengthValue(0)) / (BlockLength ? BlockLength : 1); }
+  /// \brief Is the length field value possible for this layout?
+  static constexpr bool isValidLength(const uint8_t length)
+  {
+    return (length >= lengthValue(0)) && (BlockLength ? ((length - lengthValue(0)) % (BlockLength ? BlockLength : 1)) == 0 : length == lengthValue(0));
+  }
+
+  /// \brief Address, length and command of a request with n blocks
+  static void writeHeader(uint8_t frame[], const uint8_t slaveAddress, const uint8_t n)
+  {
+    frame[ADDRESS_FIELD] = (uint8_t)(ROMER_MASTER_NIBBLE_TX | slaveAddress);
+    frame[LENGTH_FIELD]  = lengthValue(n);
+    frame[COMMAND_FIELD] = Command;
+  }
+
+  /// \brief Appends the CRC8, returns the frame length
+  static uint8_t seal(uint8_t frame[], const uint8_t n)
+  {
+    frame[crcField(n)] = Crc8::compute(frame, crcField(n));
+    return frameLength(n);
+  }
+
+  /// \brief Checks command and length of a received frame (address and CRC8 are checked by the parser)
+  /// \return RC_OK, RC_INV_UART1_COMMAND or RC_INV_UART1_LENGTH
+  static uint8_t check(const uint8_t frame[], const uint8_t maxBlocks)
+  {
+    if (frame[COMMAND_FIELD] != Command)                        return RC_INV_UART1_COMMAND;
+    if (!isValidLength(frame[LENGTH_FIELD]))                    return RC_INV_UART1_LENGTH;
+    if (numberOfBlocks(frame[LENGTH_FIELD]) > maxBlocks)        return RC_INV_UART1_LENGTH;
+    return RC_OK;
+  }
+
+  static uint32_t readUint32(const uint8_t frame[], const uint8_t field)
+  {
+    return ((uint32_t)frame[field + 3] << 24) | ((uint32_t)frame[field + 2] << 16) | ((uint32_t)frame[field + 1] << 8) | frame[field];
+  }
+
+  static void writeUint32(uint8_t frame[], const uint8_t field, const uint32_t value)
+  {
+    frame[field]     = (uint8_t)(value & 0xFF);
+    frame[field + 1] = (uint8_t)((value >> 8) & 0xFF);
+    frame[field + 2] = (uint8_t)((value >> 16) & 0xFF);
+    frame[field + 3] = (uint8_t)(value >> 24);
+  }
+
+  static void writeUint16(uint8_t frame[], const uint8_t field, const uint16_t value)
+  {
+    frame[field]     = (uint8_t)(value & 0xFF);
+    frame[field + 1] = (uint8_t)(value >> 8);
+  }
+};
+
+// ----------------------------------------------------------------------------
+// B command: read angles
+// | Address Field | Length | Command | Number of Angles | CRC8
+// Reply: | Address Field | Length | Command | Angle Info | Angle LSB | Angle | Angle | Angle MSB | ... | CRC8
+struct RomerBRequest : RomerLayout<0x42, 1, 0>
+{
+  static constexpr uint8_t NUMBER_FIELD = DATA_FIELD;
+};
+
+struct RomerBReply : RomerLayout<0x42, 0, 5>
+{
+  static constexpr uint8_t ANGLE_INFO_OFFSET = 0; /// In the angle block
+  static constexpr uint8_t ANGLE_OFFSET      = 1; /// LSB first
+};
+
+// G command: read registers
+// | Address Field | Length | Command | Register LSB | Register MSB | Number of Registers | CRC8
+// Reply: | Address Field | Length | Command | Value LSB | Value | Value | Value MSB | ... | CRC8
+struct RomerGRequest : RomerLayout<0x47, 3, 0>
+{
+  static constexpr uint8_t REGISTER_FIELD = DATA_FIELD;     /// LSB first
+  static constexpr uint8_t NUMBER_FIELD   = DATA_FIELD + 2;
+};
+
+struct RomerGReply : RomerLayout<0x47, 0, 4> {};
+
+// W command: write registers, counterpart of the G command
+// | Address Field | Length | Command | Register LSB | Register MSB | Number of Registers | Value LSB | ... | Value MSB | ... | CRC8
+// Reply: | Address Field | Length | Command | CRC8
+struct RomerWRequest : RomerLayout<0x57, 3, 4>
+{
+  static constexpr uint8_t REGISTER_FIELD = DATA_FIELD;
+  static constexpr uint8_t NUMBER_FIELD   = DATA_FIELD + 2;
+};
+
+struct RomerWReply : RomerLayout<0x57, 0, 0> {};
+
+// ----------------------------------------------------------------------------
+/// \brief     Constant read register request, e.g. the probe after power up
+///
+template<uint8_t SlaveAddress, uint16_t RegisterAddress, uint8_t NumberOfRegisters> struct RomerGRequestFrame :
+  RomerFrame<ROMER_MASTER_NIBBLE_TX | SlaveAddress, RomerGRequest::lengthValue(0), RomerGRequest::COMMAND,
+             (uint8_t)(RegisterAddress & 0xFF), (uint8_t)(RegisterAddress >> 8), NumberOfRegisters> {};
+
+/// \brief     Constant angle request
+template<uint8_t SlaveAddress, uint8_t NumberOfAngles> struct RomerBRequestFrame :
+  RomerFrame<ROMER_MASTER_NIBBLE_TX | SlaveAddress, RomerBRequest::lengthValue(0), RomerBRequest::COMMAND, NumberOfAngles> {};
+
+// Layouts as in the HA40+ documentation
+static_assert(RomerBRequest::frameLength(0) == 5,  "B command: 5 bytes");
+static_assert(RomerBReply::frameLength(1) == 9,    "B reply with one angle: 9 bytes");
+static_assert(RomerBReply::lengthValue(8) == 42,   "B reply with 8 angles: length 2 + 5N");
+static_assert(RomerGRequest::lengthValue(0) == 5,  "G command: length 5");
+static_assert(RomerGReply::frameLength(1) == 8,    "G reply with one register: 8 bytes");
+static_assert(RomerWRequest::lengthValue(1) == 9,  "W command with one register: length 9");
+static_assert(RomerWReply::frameLength(0) == 4,    "W reply: 4 bytes");
+// CRC8 of constant frames: standard check value (tables: Crc8.hpp)
+static_assert(RomerCrc8<0, '1', '2', '3', '4', '5', '6', '7', '8', '9'>::value == 0xA1, "CRC8 check value");
@@ -0,0 +1,265 @@
+// ****************************************************************************
+/// \file      RomerFrameParser.cpp
+///
+/// \brief     Byte-stream parser for Romer frames
+///
+/// \details   Hunts for the address / length header, validates the CRC8 and
+///            resynchronizes after garbage, dropped or corrupted bytes.
+///            A glitch costs one frame, the following frames are found again.
+///            The bytes are scanned in place in the RX ring of the SerialHandler,
+///            a valid frame is a view into the ring until releaseFrame().
+///
+/// \author    Christoph Capiaghi
+///
+/// \version   0.1
+///
+/// \date      20221017
+/// 
+/// \copyright Licensed under the Apache License, Version 2.0 (the "License");
+/// you may not use this file except in compliance with the License.
+/// You may obtain a copy of the License at
+/// http://www.apache.org/licenses/LICENSE-2.0
+///
+/// \pre       
+///
+/// \bug       
+///
+/// \warning   
+///
+/// \todo     
+///
+
+#include "RomerFrameParser.hpp"
+#include "config.hpp"
+#include "Crc8.hpp"
+
+static_assert(SerialHandler::RX_MAX_VIEW_LENGTH >= RomerFrameParser::ROMER_MAX_FRAME_LENGTH, "A frame view must not wrap");
+
+RomerFrameParser::RomerFrameParser() : m_serialHandler(0),
+  m_position(0),
+  m_count(0),
+  m_crc(0),
+  m_crcCount(0),
+  m_frame(0),
+  m_framePosition(0),
+  m_frameLength(0),
+  m_discardedBytes(0),
+  m_crcErrors(0),
+  m_framingErrors(0)
+{
+
+}
+
+// ----------------------------------------------------------------------------
+/// \brief     Initialize parser
+/// \detail    Frames are parsed from the RX ring of serialHandler
+/// \warning   
+/// \return    
+/// \todo      
+///
+void RomerFrameParser::initialize(SerialHandler* serialHandler)
+{
+  m_serialHandler = serialHandler;
+  reset();
+}
+
+// ----------------------------------------------------------------------------
+/// \brief     Reset parser
+/// \detail    Drops a partially received frame and releases its bytes, a valid
+///            frame is released too. Statistics are kept.
+/// \warning   
+/// \return    
+/// \todo      
+///
+void RomerFrameParser::reset()
+{
+  releaseFrame();
+  if (m_serialHandler)
+  {
+    m_serialHandler->releaseRx(m_position, m_count);
+    m_position = m_serialHandler->getRxPosition();
+  }
+  m_count       = 0;
+  m_crc         = 0;
+  m_crcCount    = 0;
+}
+
+// ----------------------------------------------------------------------------
+/// \brief     Parse the next received byte
+/// \detail    Takes the oldest byte of the ring behind the candidate into it, in
+///            place. The CRC8 is accumulated byte by byte, it is known when the last
+///            byte of the frame arrives: no second pass over the frame.
+///            A valid frame which is not released yet is released first.
+/// \warning   Only if the ring holds more than getCandidateLength() bytes
+/// \return    RC_OK if a valid frame is complete (see getFrame()),
+///            RC_INV_UART1_CRC / RC_INV_UART1_LENGTH if a frame candidate was rejected,
+///            RC_BUSY if more bytes are needed
+/// \todo      
+///
+uint8_t RomerFrameParser::parse()
+{
+  releaseFrame();
+  if (m_position != m_serialHandler->getRxPosition())
+  {
+    // Bytes read past the parser, e.g. by the drain of a new transaction
+    m_position = m_serialHandler->getRxPosition();
+    m_count    = 0;
+    m_crc      = 0;
+    m_crcCount = 0;
+  }
+  if (m_count >= ROMER_MAX_FRAME_LENGTH) discard(1); // Can not happen with a valid length field
+  m_count++;
+  return scan();
+}
+
+// ----------------------------------------------------------------------------
+/// \brief     Bytes of the frame candidate
+/// \detail    The ring bytes behind them are not parsed yet
+/// \warning   
+/// \return    
+/// \todo      
+///
+uint8_t RomerFrameParser::getCandidateLength()
+{
+  return m_count;
+}
+
+// ----------------------------------------------------------------------------
+/// \brief     Get last valid frame
+/// \detail    View into the RX ring, no copy. Valid until releaseFrame(), reset()
+///            or the next parse()
+/// \warning   
+/// \return    Pointer to the frame, starting with the address field. 0: none
+/// \todo      
+///
+const uint8_t* RomerFrameParser::getFrame()
+{
+  return m_frame;
+}
+
+// ----------------------------------------------------------------------------
+/// \brief     Release the last valid frame
+/// \detail    Call once the frame is decoded, the ring reuses its bytes
+/// \warning   
+/// \return    
+/// \todo      
+///
+void RomerFrameParser::releaseFrame()
+{
+  if (m_frame == 0) return;
+  m_serialHandler->releaseRx(m_framePosition, m_frameLength);
+  m_frame       = 0;
+  m_frameLength = 0;
+}
+
+uint8_t RomerFrameParser::getFrameLength()
+{
+  return m_frameLength;
+}
+
+uint32_t RomerFrameParser::getDiscardedBytes()
+{
+  return m_discardedBytes;
+}
+
+uint32_t RomerFrameParser::getCrcErrors()
+{
+  return m_crcErrors;
+}
+
+uint32_t RomerFrameParser::getFramingErrors()
+{
+  return m_framingErrors;
+}
+
+/// <summary>
+/// Searches the buffered bytes for a valid frame.
+/// After a rejected candidate only its first byte is dropped and the hunt
+/// restarts with the following bytes, so a frame behind the glitch is not lost.
+/// The CRC8 runs over the frame including its CRC field: 0 if the frame is intact.
+/// Only a resync (bytes dropped from the front) recalculates it over the buffered bytes.
+/// </summary>
+/// <returns>RC_OK, RC_BUSY or the error of the last rejected candidate</returns>
+uint8_t RomerFrameParser::scan()
+{
+  uint8_t errorCode = RC_BUSY;
+
+  while (m_count > 0)
+  {
+    // Hunt for the address field
+    if (!isAddress(peek(ROMER_ADDRESS_FIELD)))
+    {
+      discard(1);
+      m_discardedBytes++;
+      continue;
+    }
+    if (m_count < ROMER_HEADER_LENGTH) break;
+
+    // Length field
+    uint16_t frameLength = peek(ROMER_LENGTH_FIELD) + ROMER_HEADER_LENGTH; // 16 bit: no wrap for a length field near 0xFF
+    if (peek(ROMER_LENGTH_FIELD) < ROMER_MIN_LENGTH || frameLength > ROMER_MAX_FRAME_LENGTH)
+    {
+      m_framingErrors++;
+      errorCode = RC_INV_UART1_LENGTH;
+      discard(1);
+      m_discardedBytes++;
+      continue;
+    }
+    while (m_crcCount < m_count && m_crcCount < frameLength)
+    {
+      m_crc = Crc8::update(m_crc, peek(m_crcCount++));
+    }
+    if (m_count < frameLength) break;
+
+    // CRC8 over the whole frame including the CRC itself
+    if (m_crc != 0)
+    {
+      m_crcErrors++;
+      errorCode = RC_INV_UART1_CRC;
+      discard(1);
+      m_discardedBytes++;
+      continue;
+    }
+
+    // The frame stays in the ring, the next candidate starts behind it
+    m_frame          = m_serialHandler->getRxView(0);
+    m_framePosition  = m_position;
+    m_frameLength    = frameLength;
+    m_position      += frameLength;
+    m_count          = 0;
+    m_crc            = 0;
+    m_crcCount       = 0;
+    return RC_OK;
+  }
+  return errorCode;
+}
+
+/// <summary>
+/// Byte of the candidate
+/// </summary>
+uint8_t RomerFrameParser::peek(const uint8_t offset)
+{
+  return m_serialHandler->peekRx(offset);
+}
+
+/// <summary>
+/// Removes bytes from the front of the candidate and releases them in the ring
+/// </summary>
+/// <param name="count">Number of bytes to remove</param>
+void RomerFrameParser::discard(uint8_t count)
+{
+  if (count > m_count) count = m_count;
+  m_serialHandler->releaseRx(m_position, count);
+  m_position += count;
+  m_count    -= count;
+  m_crc       = 0;
+  m_crcCount  = 0;
+}
+
+/// <summary>
+/// Address field of a reply: slave (high nibble) to master (low nibble 0xF)
+/// </summary>
+bool RomerFrameParser::isAddress(const uint8_t data)
+{
+  return ((data & ROMER_ADDRESS_MASK) == ROMER_MASTER_ADDRESS) && ((data >> 4) != ROMER_MASTER_ADDRESS);
+}
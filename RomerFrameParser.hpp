@@ -0,0 +1,51 @@
+#pragma once
+
+#include <stdint.h>
+#include "SerialHandler.hpp"
+
+class RomerFrameParser
+{
+public:
+
+    RomerFrameParser();
+    void initialize(SerialHandler* serialHandler);
+    void reset();
+    uint8_t parse();
+    uint8_t getCandidateLength();
+    const uint8_t* getFrame();
+    uint8_t getFrameLength();
+    void releaseFrame();
+    uint32_t getDiscardedBytes();
+    uint32_t getCrcErrors();
+    uint32_t getFramingErrors();
+
+    static const uint8_t ROMER_MAX_FRAME_LENGTH   = 48;   /// Largest frame: B command reply with 8 angles (44 bytes)
+
+private:
+    //Romer Protocol
+    // | Address Field | Length | Command | Data ... | CRC8
+    // Length: number of bytes after the length field, including the CRC
+    static const uint8_t ROMER_ADDRESS_FIELD      = 0;
+    static const uint8_t ROMER_LENGTH_FIELD       = 1;
+    static const uint8_t ROMER_HEADER_LENGTH      = 2;    /// Address + Length
+    static const uint8_t ROMER_MIN_LENGTH         = 2;    /// Command + CRC
+    static const uint8_t ROMER_MASTER_ADDRESS     = 0x0F; /// Destination nibble of all replies
+    static const uint8_t ROMER_ADDRESS_MASK       = 0x0F;
+
+    SerialHandler* m_serialHandler;             /// RX ring, the frame candidate are its oldest bytes
+    uint16_t m_position;                        /// Ring position of the candidate
+    uint8_t  m_count;                           /// Bytes of the candidate
+    uint8_t  m_crc;                             /// CRC8 of the first m_crcCount bytes of the candidate
+    uint8_t  m_crcCount;                        /// Bytes covered by m_crc
+    const uint8_t* m_frame;                     /// View of the last valid frame in the ring, 0: none
+    uint16_t m_framePosition;                   /// Ring position of m_frame
+    uint8_t  m_frameLength;                     /// Length of the last valid frame
+    uint32_t m_discardedBytes;                  /// Bytes dropped while hunting for a header
+    uint32_t m_crcErrors;                       /// Frames with invalid CRC8
+    uint32_t m_framingErrors;                   /// Headers with invalid length field
+
+    uint8_t scan();
+    uint8_t peek(const uint8_t offset);
+    void discard(uint8_t count);
+    bool isAddress(const uint8_t data);
+};
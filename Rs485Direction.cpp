@@ -0,0 +1,208 @@
+// ****************************************************************************
+/// \file      Rs485Direction.cpp
+///
+/// \brief     Direction control of the RS-485 transceiver, driven by TX complete
+///
+/// \details   The driver enable pin goes high when a frame is queued and low when
+///            the transmitter reports that the last stop bit is out. The caller does
+///            not wait: a one-shot timer expires at the expected end of the frame,
+///            its interrupt checks the TX complete flag of the UART and drops the
+///            pin, or checks again one character later. The turnaround takes a few
+///            microseconds instead of a flush() and two fixed delays.
+///            The hardware access is behind Rs485Hal: SAMD51 (TC5 and the SERCOM of
+///            Serial1) below, the host simulation in sim/arduino.cpp. The host
+///            backend also checks the turnaround timing against the simulated line.
+///
+/// \author    Christoph Capiaghi
+///
+/// \version   0.1
+///
+/// \date      20221017
+///
+/// \copyright Licensed under the Apache License, Version 2.0 (the "License");
+/// you may not use this file except in compliance with the License.
+/// You may obtain a copy of the License at
+/// http://www.apache.org/licenses/LICENSE-2.0
+///
+/// \pre
+///
+/// \bug
+///
+/// \warning   One instance only, there is one timer. The driver enable time of the
+///            transceiver must be shorter than the time from digitalWrite() to the
+///            first start bit, about 1 us: no setup delay any more.
+///
+/// \todo      Hardware RS-485 mode of the SERCOM (TXPO 3) if DE is wired to PAD2
+///
+
+#include <arduino.h>
+#include "Rs485Direction.hpp"
+#include "config.hpp"
+
+#if defined(__SAMD51__)
+static const uint32_t TIMER_CLOCK_HZ     = 48000000UL / 16;   /// GCLK1 (48 MHz) / prescaler
+static const uint32_t TIMER_MAX_TICKS    = 0x10000;           /// 16 bit, longer delays expire early and recheck
+static const uint8_t  TIMER_IRQ_PRIORITY = 2;                 /// Above TC3 (EncoderSampler), which queues the frames
+#endif
+
+static Rs485Direction* s_direction = 0;                       /// Instance of the timer interrupt
+
+Rs485Direction::Rs485Direction() : m_pin(NO_PIN),
+  m_transmitting(false),
+  m_recheckUs(100)
+{
+
+}
+
+// ----------------------------------------------------------------------------
+/// \brief     Initialize the direction control
+/// \detail    The transceiver listens until the first frame
+/// \warning
+/// \return
+/// \todo
+///
+void Rs485Direction::initialize(const uint8_t pin)
+{
+  m_pin       = pin;
+  s_direction = this;
+  pinMode(m_pin, OUTPUT);
+  Rs485Hal::initialize();
+  enableReceive();
+}
+
+// ----------------------------------------------------------------------------
+/// \brief     Driver on, call before the frame is written
+/// \detail    A turnaround still pending from the last frame is cancelled
+/// \warning   Call after initialize()
+/// \return
+/// \todo
+///
+void Rs485Direction::enableTransmit()
+{
+  Rs485Hal::stopTimer();
+  m_transmitting = true;
+  digitalWrite(m_pin, HIGH);
+}
+
+// ----------------------------------------------------------------------------
+/// \brief     Driver off as soon as the frame is out, without waiting
+/// \detail    txEndUs: expected end of the last stop bit (micros() time),
+///            charTimeUs: recheck interval if the transmitter is not done by then
+/// \warning   Call after the frame is written
+/// \return
+/// \todo
+///
+void Rs485Direction::releaseAt(const uint32_t txEndUs, const uint32_t charTimeUs)
+{
+  m_recheckUs = charTimeUs;
+  int32_t delayUs = (int32_t)(txEndUs - micros());
+  Rs485Hal::startTimer((delayUs > 0) ? (uint32_t)delayUs : 1);
+}
+
+// ----------------------------------------------------------------------------
+/// \brief     Driver off now
+/// \detail    After flush(), or to leave RS-485 mode
+/// \warning   Truncates a frame which is still being sent
+/// \return
+/// \todo
+///
+void Rs485Direction::enableReceive()
+{
+  if (m_pin == NO_PIN) return;
+  Rs485Hal::stopTimer();
+  digitalWrite(m_pin, LOW);
+  m_transmitting = false;
+}
+
+bool Rs485Direction::isTransmitting()
+{
+  return m_transmitting;
+}
+
+// ----------------------------------------------------------------------------
+/// \brief     Turnaround timer expired
+/// \warning   Interrupt context, called by the Rs485Hal backend
+///
+void Rs485Direction::timerInterrupt()
+{
+  if (s_direction) s_direction->onTimer();
+}
+
+/// <summary>
+/// Drops the driver if the transmitter is done, else checks again one character later
+/// </summary>
+void Rs485Direction::onTimer()
+{
+  if (!m_transmitting) return;
+  if (Rs485Hal::isTransmitterIdle())
+  {
+    digitalWrite(m_pin, LOW);
+    m_transmitting = false;
+    return;
+  }
+  Rs485Hal::startTimer(m_recheckUs);
+}
+
+#if defined(__SAMD51__)
+// ----------------------------------------------------------------------------
+/// \brief     TC5 as one-shot timer, stopped
+///
+void Rs485Hal::initialize()
+{
+  GCLK->PCHCTRL[TC5_GCLK_ID].reg = GCLK_PCHCTRL_GEN_GCLK1 | GCLK_PCHCTRL_CHEN;
+  while ((GCLK->PCHCTRL[TC5_GCLK_ID].reg & GCLK_PCHCTRL_CHEN) == 0);
+  MCLK->APBCMASK.reg |= MCLK_APBCMASK_TC5;
+
+  TC5->COUNT16.CTRLA.reg = TC_CTRLA_SWRST;
+  while (TC5->COUNT16.SYNCBUSY.bit.SWRST);
+  TC5->COUNT16.CTRLA.reg = TC_CTRLA_MODE_COUNT16 | TC_CTRLA_PRESCALER_DIV16;
+  TC5->COUNT16.WAVE.reg  = TC_WAVE_WAVEGEN_MFRQ;                   // Top = CC0
+  TC5->COUNT16.CTRLBSET.reg = TC_CTRLBSET_ONESHOT;
+  while (TC5->COUNT16.SYNCBUSY.bit.CTRLB);
+  TC5->COUNT16.INTENSET.reg = TC_INTENSET_OVF;
+  TC5->COUNT16.CTRLA.bit.ENABLE = 1;
+  while (TC5->COUNT16.SYNCBUSY.bit.ENABLE);
+  stopTimer();
+
+  NVIC_SetPriority(TC5_IRQn, TIMER_IRQ_PRIORITY);
+  NVIC_ClearPendingIRQ(TC5_IRQn);
+  NVIC_EnableIRQ(TC5_IRQn);
+}
+
+void Rs485Hal::startTimer(const uint32_t delayUs)
+{
+  uint32_t ticks = delayUs * (TIMER_CLOCK_HZ / 1000000UL);
+  if (ticks == 0) ticks = 1;
+  if (ticks > TIMER_MAX_TICKS) ticks = TIMER_MAX_TICKS;
+  TC5->COUNT16.CC[0].reg = (uint16_t)(ticks - 1);
+  while (TC5->COUNT16.SYNCBUSY.bit.CC0);
+  TC5->COUNT16.CTRLBSET.reg = TC_CTRLBSET_CMD_RETRIGGER;
+  while (TC5->COUNT16.SYNCBUSY.bit.CTRLB);
+}
+
+void Rs485Hal::stopTimer()
+{
+  TC5->COUNT16.CTRLBSET.reg = TC_CTRLBSET_CMD_STOP;
+  while (TC5->COUNT16.SYNCBUSY.bit.CTRLB);
+  TC5->COUNT16.INTFLAG.reg = TC_INTFLAG_OVF;
+  NVIC_ClearPendingIRQ(TC5_IRQn);
+}
+
+/// <summary>
+/// TXC: the shift register is empty and no new data was written. Writing DATA clears
+/// the flag, so it is only set after the last byte of the frame.
+/// </summary>
+bool Rs485Hal::isTransmitterIdle()
+{
+  return ENCODER_UART_SERCOM->USART.INTFLAG.bit.TXC;
+}
+
+// ----------------------------------------------------------------------------
+/// \brief     TC5 interrupt
+///
+void TC5_Handler()
+{
+  TC5->COUNT16.INTFLAG.reg = TC_INTFLAG_OVF;
+  Rs485Direction::timerInterrupt();
+}
+#endif
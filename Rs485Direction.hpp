@@ -0,0 +1,78 @@
+// ****************************************************************************
+/// \file      Rs485Direction.hpp
+///
+/// \brief     Direction control of the RS-485 transceiver, driven by TX complete
+///
+/// \details   Rs485Direction switches the driver enable pin around each frame
+///            without waiting, see Rs485Direction.cpp. Rs485Hal is its hardware,
+///            one backend per platform. UartDirection is the direction control of
+///            a plain UART: nothing to switch.
+///
+/// \author    Christoph Capiaghi
+///
+/// \version   0.1
+///
+/// \date      20221017
+///
+/// \copyright Licensed under the Apache License, Version 2.0 (the "License");
+/// you may not use this file except in compliance with the License.
+/// You may obtain a copy of the License at
+/// http://www.apache.org/licenses/LICENSE-2.0
+///
+/// \pre
+///
+/// \bug
+///
+/// \warning   One Rs485Direction instance only, there is one timer
+///
+/// \todo
+///
+
+// Prevent recursive inclusion
+#pragma once
+
+#include <stdint.h>
+
+/// \brief Hardware behind the direction control, one backend per platform:
+///        SAMD51 in Rs485Direction.cpp, host simulation in sim/arduino.cpp
+class Rs485Hal
+{
+public:
+    static void initialize();
+    static void startTimer(const uint32_t delayUs);   /// One-shot, calls Rs485Direction::timerInterrupt()
+    static void stopTimer();
+    static bool isTransmitterIdle();                  /// Last stop bit out, nothing left to send
+};
+
+class Rs485Direction
+{
+public:
+    Rs485Direction();
+    void initialize(const uint8_t pin);
+    void enableTransmit();
+    void releaseAt(const uint32_t txEndUs, const uint32_t charTimeUs);
+    void enableReceive();
+    bool isTransmitting();
+
+    static void timerInterrupt();
+
+private:
+    static const uint8_t NO_PIN = 0xFF;
+
+    uint8_t m_pin;                        /// Driver enable (DE / nRE) of the transceiver
+    volatile bool m_transmitting;         /// Driver on, waiting for the transmitter
+    uint32_t m_recheckUs;                 /// Timer delay if the transmitter is still busy: one character
+
+    void onTimer();
+};
+
+/// \brief Plain UART, or an adapter which switches the direction itself: nothing to do
+class UartDirection
+{
+public:
+    void initialize(const uint8_t) {}
+    void enableTransmit() {}
+    void releaseAt(const uint32_t, const uint32_t) {}
+    void enableReceive() {}
+    bool isTransmitting() { return false; }
+};
@@ -54,17 +54,31 @@ bool turnOffRgbStrip(Adafruit_NeoPixel *neoPixels )
 
 
 Safe::Safe() : m_errorCode(RC_OK),
+m_offsetRaw(0),
+m_nullPositionRaw(0),
+m_initStatus(INIT_NOT_COMPLETE),
+m_barGraphResolutionRaw(angleDegToRaw(1.0)),
 m_ha40p(),
-m_lock(),
-m_offsetDeg(0.0),
-m_initStatus(INIT_NOT_COMPLETE)
+m_estimator(),
+m_turnTracker(),
+m_angleStatus(RC_INV_UART1_TIMEOUT),
+m_positionRaw(0),
+m_filteredPositionRaw(0),
+m_filteredValid(false),
+m_lastReadUs(0),
+m_readCount(0),
+m_filter(),
+m_lastSampleCount(0),
+m_nullPending(false),
+m_lock()
 {
 
 }
 
 // ----------------------------------------------------------------------------
 /// \brief     Initialize Safe
-/// \detail    
+/// \detail    A missing encoder is not fatal: the encoder keeps probing in the background
+///            and the zero position is set as soon as the first angle arrives.
 /// \warning   
 /// \return    RC_Type
 /// \todo      Polarisation?
@@ -81,38 +95,246 @@ uint8_t Safe::initialize(Adafruit_Protomatter* matrix, SerialHandler *serialHand
     if (m_errorCode != RC_OK) return m_errorCode;
   
     m_errorCode       = m_ha40p.initialize(serialHandler);
-    if (m_errorCode != RC_OK) return m_errorCode;
+#ifdef DEBUG
+    if (m_ha40p.isDegraded()) Serial.println(F("Encoder not responding, running degraded"));
+    else if (m_errorCode != RC_OK) Serial.println(F("First encoder sample failed"));
+#endif
+#ifdef ENCODER_HIGH_SPEED_LINK
+    m_ha40p.negotiateBaudrate();
+#endif
+#ifdef ENCODER_PIPELINED
+    m_ha40p.setPipelineMode(true);
+#endif
+    m_estimator.initialize(ESTIMATOR_ALPHA, ESTIMATOR_BETA);
+    m_filter.initialize(ANGLE_FILTER_WINDOW, FILTER_OUTLIER_RAW);
+#ifdef ENCODER_TIMER_SAMPLING_US
+    updateEstimator(); // Sample of Encoder::initialize(), the queue starts after it
+    if (m_sampler.initialize(&m_ha40p, ENCODER_TIMER_SAMPLING_US) == RC_OK)
+    {
+#ifdef ENCODER_HARDWARE_TRIGGER_US
+      m_sampler.setHardwareTrigger(TRIGGER_PIN, ENCODER_HARDWARE_TRIGGER_US); // Falls back to B command triggers if it fails
+#endif
+      m_sampler.start();
+    }
+#endif
   
     // Get Offset
-    setNullPosition();  
+    if (readAngle() == RC_OK) setNullPosition();
+    else m_nullPending = true;
   }
   m_initStatus = INIT_COMPLETE;
   
-  return m_errorCode;
+  return RC_OK;
+}
+
+// ----------------------------------------------------------------------------
+/// \brief     Drive the encoder
+/// \detail    Collects finished angle transactions and triggers new ones.
+///            Timer sampling: only drains the sample queue, the interrupt drives the encoder.
+///            After a power cycle of the encoder its baud rate and trigger mode are restored.
+/// \warning   Call as often as possible. Blocks only for the restore after a power cycle.
+/// \return    
+/// \todo      
+///
+void Safe::update()
+{
+#ifndef ENCODER_TIMER_SAMPLING_US
+  m_ha40p.update();
+#endif
+  if (m_ha40p.isRestorePending() && !m_ha40p.isDegraded())
+  {
+#ifdef ENCODER_TIMER_SAMPLING_US
+    bool sampling = m_sampler.isRunning();
+    m_sampler.stop(); // No bus access from the interrupt during the restore
+    m_ha40p.restoreConfiguration();
+    if (sampling) m_sampler.start();
+#else
+    m_ha40p.restoreConfiguration();
+#endif
+  }
+  updateEstimator();
+  if (m_nullPending && !m_ha40p.isDegraded() && m_ha40p.getSampleCount() > 0)
+  {
+    readAngle();
+    setNullPosition();
+    m_nullPending = false;
+  }
+}
+
+// ----------------------------------------------------------------------------
+/// \brief     Angle service, once per loop tick
+/// \detail    Reads the angle at most once per tick (or per ANGLE_SERVICE_PERIOD_US).
+///            All getters of the tick (getAngleRaw, getPositionRaw, getFilteredAngleRaw,
+///            setNullPosition) return this sample, without bus access.
+///            Hardware trigger: the pulses are phase-locked to this call, one
+///            sample is latched TRIGGER_LEAD_US before every frame.
+/// \warning   Call once per loop iteration, before the games run
+/// \return    
+/// \todo      
+///
+void Safe::tick()
+{
+#ifdef ENCODER_HARDWARE_TRIGGER_US
+  m_sampler.lockToFrame(micros(), TRIGGER_LEAD_US);
+#endif
+  if (m_readCount > 0 && (micros() - m_lastReadUs) < ANGLE_SERVICE_PERIOD_US) return;
+  readAngle();
+}
+
+// ----------------------------------------------------------------------------
+/// \brief     Fresh angle read
+/// \detail    Explicit opt-in for a consumer that cannot use the sample of the tick.
+///            Replaces the cached sample for all consumers.
+/// \warning   Triggers a bus transaction if the encoder is idle
+/// \return    RC_Type
+/// \todo      
+///
+uint8_t Safe::readAngle()
+{
+  uint32_t rawAngle = 0;
+#ifdef ENCODER_TIMER_SAMPLING_US
+  updateEstimator(); // Encoder driven by the timer, no bus access from here
+  if (!m_turnTracker.isValid()) m_angleStatus = RC_INV_UART1_TIMEOUT;
+  else m_angleStatus = m_ha40p.isDegraded() ? RC_STALE : RC_OK;
+#else
+  m_angleStatus = m_ha40p.getRawAngle(rawAngle);
+  updateEstimator();
+#endif
+  m_lastReadUs = micros();
+  m_readCount++;
+
+  m_positionRaw = m_turnTracker.isValid() ? m_turnTracker.getPosition() : (int64_t)rawAngle;
+  int64_t filteredPositionRaw;
+  if (m_filter.getOutput(filteredPositionRaw) != RC_INV_UART1_TIMEOUT)
+  {
+    m_filteredPositionRaw = filteredPositionRaw;
+    m_filteredValid       = true;
+  }
+  return m_angleStatus;
+}
+
+// ----------------------------------------------------------------------------
+/// \brief     Is the encoder link down?
+/// \detail    See Encoder::isDegraded()
+/// \warning   
+/// \return    
+/// \todo      
+///
+bool Safe::isEncoderDegraded()
+{
+  return m_ha40p.isDegraded();
+}
+
+// ----------------------------------------------------------------------------
+/// \brief     Print the encoder link statistics on the debug port
+/// \detail    Counters and round-trip histogram, see Encoder::printLinkStats()
+/// \warning   
+/// \return    
+/// \todo      
+///
+void Safe::printEncoderStats()
+{
+  m_ha40p.printLinkStats();
+  Serial.print(F("Angle reads: "));
+  Serial.println(m_readCount);
+#ifdef ENCODER_TIMER_SAMPLING_US
+  Serial.print(F("Sampler ticks: "));
+  Serial.print(m_sampler.getTickCount());
+  Serial.print(F(" dropped: "));
+  Serial.println(m_sampler.getDroppedCount());
+#endif
+#ifdef ENCODER_HARDWARE_TRIGGER_US
+  Serial.print(F("Trigger pulses: "));
+  Serial.print(m_sampler.getTriggerScheduler().getPulseCount());
+  Serial.print(F(" skipped: "));
+  Serial.print(m_sampler.getTriggerScheduler().getSkippedCount());
+  Serial.print(F(" phase error [us]: "));
+  Serial.println(m_sampler.getTriggerScheduler().getPhaseErrorUs());
+#endif
+  Serial.print(F("Angle filter rejected: "));
+  Serial.println(m_filter.getRejectedCount());
+}
+
+// ----------------------------------------------------------------------------
+/// \brief     Feed new encoder samples into the estimator, the turn tracker and the filter
+/// \detail    Turn tracker and filter get every sample of a batch: fast turns unwrap
+///            correctly and the filter runs at the full encoder rate. In timer
+///            sampling the estimator gets every queued sample too, they have their
+///            own timestamps.
+/// \warning   
+/// \return    
+/// \todo      
+///
+void Safe::updateEstimator()
+{
+#ifdef ENCODER_TIMER_SAMPLING_US
+  if (m_sampler.isRunning())
+  {
+    // All samples since the last call, the interrupt keeps sampling meanwhile
+    encoder_sample_t sample;
+    while (m_sampler.pop(sample))
+    {
+      addSample(sample);
+      m_estimator.update(sample.rawAngle, sample.timestampUs);
+    }
+    return;
+  }
+#endif
+  uint32_t sampleCount = m_ha40p.getSampleCount();
+  if (sampleCount == m_lastSampleCount) return;
+  m_lastSampleCount = sampleCount;
+
+  encoder_sample_t samples[Encoder::ROMER_MAX_ANGLES_PER_REQUEST];
+  uint8_t numberOfSamples = 0;
+  m_ha40p.getAngleBatch(samples, Encoder::ROMER_MAX_ANGLES_PER_REQUEST, numberOfSamples);
+  for (uint8_t i = 0; i < numberOfSamples; i++)
+  {
+    addSample(samples[i]);
+  }
+  if (numberOfSamples > 0)
+  {
+    m_estimator.update(samples[numberOfSamples - 1].rawAngle, samples[numberOfSamples - 1].timestampUs);
+  }
+}
+
+// ----------------------------------------------------------------------------
+/// \brief     One sample into the turn tracker and the filter
+/// \detail    
+/// \warning   
+/// \return    
+/// \todo      
+///
+void Safe::addSample(const encoder_sample_t& sample)
+{
+  m_turnTracker.update(sample.rawAngle, sample.timestampUs);
+  m_filter.update(m_turnTracker.getPosition());
 }
 
 // ----------------------------------------------------------------------------
 /// \brief     Set current position to zero
-/// \detail    Used to set offset
+/// \detail    Used to set offset. Sample of the current tick, no bus access.
 /// \warning   
 /// \return    RC_Type
 /// \todo      
 ///
 void Safe::setNullPosition()
 {
-  m_errorCode       = m_ha40p.getAngleDeg(m_offsetDeg);
+  m_nullPositionRaw = m_positionRaw;
+  m_offsetRaw       = (uint32_t)m_positionRaw;
 }
 
 // ----------------------------------------------------------------------------
 /// \brief     Set current offset
-/// \detail    
+/// \detail    Raw counts, see Angle.hpp. Zero position in the first turn of the
+///            multi-turn position
 /// \warning   
 /// \return    RC_Type
 /// \todo      
 ///
-void Safe::setOffsetDeg(const float offset)
+void Safe::setOffsetRaw(const uint32_t offsetRaw)
 {
-  m_offsetDeg = offset;
+  m_nullPositionRaw = offsetRaw;
+  m_offsetRaw       = offsetRaw;
 }
 
 // ----------------------------------------------------------------------------
@@ -175,26 +397,20 @@ uint8_t Safe::displayCode(const uint8_t * digits)
 /// \return    RC_Type
 /// \todo      
 ///
-uint8_t Safe::getAndDisplayAngles(const float targetAngleDeg, float& angleDeg)
+uint8_t Safe::getAndDisplayAngles(const uint32_t targetAngleRaw, uint32_t& angleRaw)
 {
   uint8_t m_errorCode = RC_OK;
   // Get Encoder Angle and calculate degree, minute and seconds
-  // https://de.planetcalc.com/1129/
-  m_errorCode = m_ha40p.getAngleDeg(angleDeg);
-  angleDeg -= m_offsetDeg;
-  if (angleDeg < 0) angleDeg += 360.0;
-
-  m_degree = (uint16_t) angleDeg;
-  float rest = angleDeg - m_degree;
-  m_minute = (uint16_t)(rest * 60.0);
-#ifdef DEBUG
-  Serial.print("Rest Deg: "); Serial.println(rest);
-#endif
-  rest = rest - ((float)m_minute / 60.0);
-#ifdef DEBUG
-  Serial.print("Rest Deg: "); Serial.println(rest);
-#endif
-  m_seconds = (uint16_t)(rest * 3600.0);
+  // Integer math on arc seconds, no float in the hot path
+  // angleRaw: measured (for the game), display: predicted for the time of rendering
+  m_errorCode = getFilteredAngleRaw(angleRaw);
+  uint32_t displayAngleRaw = angleRaw;
+  getPredictedAngleRaw(displayAngleRaw);
+
+  uint32_t arcSeconds = angleRawToArcSeconds(displayAngleRaw);
+  m_degree  = (uint16_t)(arcSeconds / 3600);
+  m_minute  = (uint16_t)((arcSeconds / 60) % 60);
+  m_seconds = (uint16_t)(arcSeconds % 60);
 #ifdef DEBUG
   Serial.print("Angle Deg: "); Serial.println(m_degree);
   Serial.print("Angle Min: "); Serial.println(m_minute);
@@ -214,12 +430,12 @@ uint8_t Safe::getAndDisplayAngles(const float targetAngleDeg, float& angleDeg)
 
   // x, y, w, h, color
   // Calculate bar graph
-  float differenceDeg = abs(targetAngleDeg - angleDeg);
-  float barLength = 0.0;
-  if (differenceDeg > m_barGraphResolution) differenceDeg = m_barGraphResolution;
-  barLength = WIDTH - differenceDeg / m_barGraphResolution * WIDTH;
+  uint32_t differenceRaw = angleRawDistance(targetAngleRaw, angleRaw);
+  if (differenceRaw > m_barGraphResolutionRaw) differenceRaw = m_barGraphResolutionRaw;
+  int16_t barLength = WIDTH - (int16_t)(((uint64_t)differenceRaw * WIDTH) / m_barGraphResolutionRaw);
 
   m_matrix->fillRect(0, 30, barLength , 2, GREEN);
+  if (m_ha40p.isStale()) m_matrix->fillRect(WIDTH - 2, 0, 2, 2, RED); // Encoder link down, frozen angle
 
   m_matrix->show();
   return RC_OK;
@@ -288,28 +504,127 @@ void Safe::resetDisplay()
 
 // ----------------------------------------------------------------------------
 /// \brief     Set bar graph resolution
-/// \detail    
+/// \detail    Difference to the target angle, where the bar graph is empty. Raw counts.
 /// \warning   
 /// \return    
 /// \todo      
 ///
-void Safe::setBarGraphResolution( const float barGraphResolution)
+void Safe::setBarGraphResolution( const uint32_t barGraphResolutionRaw)
 {
-  m_barGraphResolution = barGraphResolution;
+  m_barGraphResolutionRaw = (barGraphResolutionRaw > 0) ? barGraphResolutionRaw : 1;
 }
 
 
 // ----------------------------------------------------------------------------
-/// \brief     Get angle in degree
+/// \brief     Get angle relative to the zero position
+/// \detail    Raw counts, offset subtracted modulo 2^32. Sample of the current tick.
+/// \warning   
+/// \return    RC_Type
+/// \todo      
+///
+uint8_t Safe::getAngleRaw( uint32_t& angleRaw)
+{
+  angleRaw = (uint32_t)m_positionRaw - m_offsetRaw;
+  return m_angleStatus;
+}
+
+// ----------------------------------------------------------------------------
+/// \brief     Get predicted angle relative to the zero position
+/// \detail    Extrapolated to now from the timestamped samples, no bus transaction.
+///            While the encoder link is down the last estimate is held, not extrapolated.
+/// \warning   angleRaw is unchanged if no sample was received yet
+/// \return    RC_Type
+/// \todo      
+///
+uint8_t Safe::getPredictedAngleRaw( uint32_t& angleRaw)
+{
+  if (!m_estimator.isValid()) return RC_INV_UART1_TIMEOUT;
+  if (m_ha40p.isStale())
+  {
+    angleRaw = m_estimator.getAngle() - m_offsetRaw;
+    return RC_STALE;
+  }
+  angleRaw = m_estimator.predict(micros()) - m_offsetRaw;
+  return RC_OK;
+}
+
+// ----------------------------------------------------------------------------
+/// \brief     Get multi-turn position relative to the zero position
+/// \detail    Raw counts, 2^32 per revolution, continuous across 0 / 360 degree.
+///            The low 32 bit are the same as getAngleRaw(). Sample of the current tick.
+/// \warning   positionRaw is unchanged if no sample was received yet
+/// \return    RC_Type
+/// \todo      
+///
+uint8_t Safe::getPositionRaw( int64_t& positionRaw)
+{
+  if (!m_turnTracker.isValid()) return RC_INV_UART1_TIMEOUT;
+  positionRaw = m_positionRaw - m_nullPositionRaw;
+  return m_angleStatus;
+}
+
+// ----------------------------------------------------------------------------
+/// \brief     Get filtered angle relative to the zero position
+/// \detail    Average of the last ANGLE_FILTER_WINDOW samples, outliers replaced by
+///            the median. Taken once per tick: all samples since the last tick count.
+/// \warning   angleRaw is unchanged if no sample was received yet
+/// \return    RC_Type
+/// \todo      
+///
+uint8_t Safe::getFilteredAngleRaw( uint32_t& angleRaw)
+{
+  if (!m_filteredValid) return RC_INV_UART1_TIMEOUT;
+  angleRaw = (uint32_t)m_filteredPositionRaw - m_offsetRaw;
+  return m_angleStatus;
+}
+
+// ----------------------------------------------------------------------------
+/// \brief     Get number of full turns
+/// \detail    Since power-up, not relative to the zero position
+/// \warning   
+/// \return    Turns, negative: counted down
+/// \todo      
+///
+int32_t Safe::getTurns()
+{
+  return m_turnTracker.getTurns();
+}
+
+// ----------------------------------------------------------------------------
+/// \brief     Get direction of rotation
+/// \detail    See TurnTracker::getDirection()
+/// \warning   
+/// \return    +1: counting up, -1: counting down, 0: not moved yet
+/// \todo      
+///
+int8_t Safe::getDirection()
+{
+  return m_turnTracker.getDirection();
+}
+
+// ----------------------------------------------------------------------------
+/// \brief     Get angular velocity
 /// \detail    
 /// \warning   
+/// \return    Degree per second, positive: counting up
+/// \todo      
+///
+float Safe::getAngularVelocityDegPerS()
+{
+  return m_estimator.getVelocity() * (360.0f * 1000000.0f / 4294967296.0f);
+}
+
+// ----------------------------------------------------------------------------
+/// \brief     Get angle in degree
+/// \detail    Relative to the zero position, 0 ... 360 degree
+/// \warning   
 /// \return    RC_Type
 /// \todo      
 ///
 uint8_t Safe::getAngleDeg( float& angleDeg)
 {
-  m_errorCode = m_ha40p.getAngleDeg(angleDeg);
-  angleDeg -= m_offsetDeg;
-  if (angleDeg < 0) angleDeg += 360.0;
-  return m_errorCode;
+  uint32_t angleRaw;
+  uint8_t errorCode = getAngleRaw(angleRaw);
+  angleDeg = angleRawToDeg(angleRaw);
+  return errorCode;
 }
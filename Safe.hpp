@@ -4,6 +4,10 @@
 #include <Adafruit_Protomatter.h>
 #include <Adafruit_NeoPixel.h>
 #include "Encoder.hpp"
+#include "AngleEstimator.hpp"
+#include "TurnTracker.hpp"
+#include "AngleFilter.hpp"
+#include "EncoderSampler.hpp"
 #include "Lock.hpp"
 #include <arduino-timer.h>
 
@@ -14,18 +18,30 @@ public:
   uint8_t initialize(Adafruit_Protomatter* matrix, SerialHandler *serialHandler, Adafruit_NeoPixel *neoPixels, Timer<1, millis, Adafruit_NeoPixel *>* rbgStripTimer);
 	void reset();
   uint8_t run();
+  void update();
+  void tick();
+  uint8_t readAngle();
+  void printEncoderStats();
+  bool isEncoderDegraded();
   uint8_t openSafe();
-  uint8_t getAndDisplayAngles(const float targetAngleDeg, float& angleDeg);
+  uint8_t getAndDisplayAngles(const uint32_t targetAngleRaw, uint32_t& angleRaw);
   uint8_t displayCode(const uint8_t * digits);
-  void setOffsetDeg(const float offset);
+  void setOffsetRaw(const uint32_t offsetRaw);
   void resetDisplay();
+  uint8_t getAngleRaw( uint32_t& angleRaw);
+  uint8_t getPredictedAngleRaw( uint32_t& angleRaw);
+  uint8_t getPositionRaw( int64_t& positionRaw);
+  uint8_t getFilteredAngleRaw( uint32_t& angleRaw);
+  int32_t getTurns();
+  int8_t getDirection();
+  float getAngularVelocityDegPerS();
   uint8_t getAngleDeg( float& angleDeg);
   void displayHexagonLogo();
   void displayGreenSmiley();
   void displayRedSmiley();
   void showHtcRules();
   void setNullPosition();
-  void setBarGraphResolution(const float barGraphResolution);
+  void setBarGraphResolution(const uint32_t barGraphResolutionRaw);
 
 private:
 
@@ -36,15 +52,19 @@ private:
 
   static const uint32_t RGB_STRIP_ILLUMINATION_TIME_S = 15; // How long should be the led in the safe on in seconds
 
+  static constexpr float ESTIMATOR_ALPHA = 0.5;                                              /// Alpha-beta filter, position gain
+  static constexpr float ESTIMATOR_BETA  = ESTIMATOR_ALPHA * ESTIMATOR_ALPHA / (2.0 - ESTIMATOR_ALPHA); /// Benedict-Bordner, 0.167: tracks faster than critical damping (0.086), slightly underdamped
+  static constexpr uint32_t FILTER_OUTLIER_RAW = angleDegToRaw(1.0);                         /// Max. distance to the median of the filter window
+  static const uint32_t TRIGGER_LEAD_US = 1000;                                              /// Hardware trigger: latch this long before the frame, the readout is done by then
+
 	uint8_t m_errorCode;
-	float m_offset;
-  float m_offsetDeg;
+  uint32_t m_offsetRaw;               /// Zero position in raw counts
+  int64_t  m_nullPositionRaw;         /// Zero position, multi-turn: low 32 bit are m_offsetRaw
   int8_t m_currentCode[NUMBER_OF_CODE_DIGITS];
   uint8_t m_initStatus;
-  float m_barGraphResolution;
+  uint32_t m_barGraphResolutionRaw;   /// Full bar graph range in raw counts
    
  
-	float m_lastAngleDeg;
 	uint32_t m_lastDebounceTime;
 	uint8_t codeNumber;
 	uint8_t countDirection;
@@ -59,6 +79,20 @@ private:
 
 	// Angle Encoder HA40+ -----------------------------------------------------
 	Encoder m_ha40p;
+#ifdef ENCODER_TIMER_SAMPLING_US
+  EncoderSampler m_sampler;       /// Drives m_ha40p from the timer interrupt
+#endif
+  AngleEstimator m_estimator;     /// Angle and velocity from timestamped samples
+  TurnTracker m_turnTracker;      /// Multi-turn position, fed with every sample
+  uint8_t  m_angleStatus;         /// Status of the last read (tick)
+  int64_t  m_positionRaw;         /// Multi-turn position of the last read, without offset
+  int64_t  m_filteredPositionRaw; /// Filter output of the last read, without offset
+  bool     m_filteredValid;       /// m_filteredPositionRaw holds a value
+  uint32_t m_lastReadUs;          /// Time of the last read
+  uint32_t m_readCount;           /// Reads since power-up
+  AngleFilter m_filter;           /// Median / average of the last samples, read once per frame
+  uint32_t m_lastSampleCount;     /// Sample count of the last sample fed to m_estimator
+  bool m_nullPending;             /// Encoder was down at init, zero position not set yet
 
 	// Lock-style Solenoid -----------------------------------------------------
 	Lock m_lock;
@@ -67,6 +101,8 @@ private:
   Timer<1, millis, Adafruit_NeoPixel *>* m_rbgStripTimer;
   
 	uint8_t directionChanged();
+  void updateEstimator();
+  void addSample(const encoder_sample_t& sample);
 
 
 };
@@ -38,6 +38,8 @@
 /// \todo      Polarisation?
 ///
 SafeGame::SafeGame() : m_errorCode(RC_OK),
+                       m_positionRaw(0),
+                       m_digitStartPositionRaw(0),
                        m_currentDigit(1)
 {
 
@@ -110,6 +112,8 @@ uint8_t SafeGame::run()
       stm_newState  = STM_STATE_SAFE_FIRST_DIGIT;
       stm_entryFlag = FALSE;
       stm_exitFlag  = TRUE;
+      m_safe->setNullPosition(); // Set current offset to zero position, sample of this tick
+      m_safe->getPositionRaw(m_digitStartPositionRaw);
     }
     
     // Init with not yet defined
@@ -118,7 +122,6 @@ uint8_t SafeGame::run()
         m_currentCode[digit] = UNDEFINED_CODE_ELEMENT;
     }
     m_sign = (-1);
-    m_safe->setNullPosition(); // Set current offset to zero position
     m_safe->displayCode(m_currentCode); /// Show XXXX
 
     // Exit
@@ -148,20 +151,22 @@ uint8_t SafeGame::run()
       m_first = true;
     }
 
-    m_errorCode = m_safe->getAngleDeg(m_angleDeg); // Get position
+    m_errorCode = m_safe->getPositionRaw(m_positionRaw); // Get position
     
+    // Relative to the start of the digit, modulo 2^32. Counter clockwise: 360 degree - angle
+    m_angleRaw = (uint32_t)(m_positionRaw - m_digitStartPositionRaw);
     if ( m_sign == -1)
     {
-      m_angleDeg = 360.0 - m_angleDeg;
+      m_angleRaw = 0UL - m_angleRaw;
     }
 
     // Search code segment
     m_code_found = false;
     for (uint8_t i = 0; i < NUMBER_OF_CODE_DISK_ELEMENTS && !m_code_found; i++)
     {
-      m_currentCodeElementAngle = STEP_SIZE*i;
+      m_currentCodeElementAngleRaw = (uint32_t)(((uint64_t)i << 32) / NUMBER_OF_CODE_DISK_ELEMENTS);
       
-      if (m_angleDeg < (m_currentCodeElementAngle + TOLERANCE) && m_angleDeg > (m_currentCodeElementAngle - TOLERANCE))
+      if (angleRawDistance(m_angleRaw, m_currentCodeElementAngleRaw) < TOLERANCE_RAW)
       {
         m_currentCodeElement = i;
         m_code_found = true;
@@ -199,7 +204,7 @@ uint8_t SafeGame::run()
       else
       {
         m_sign *= (-1); // Change sign
-        m_safe->setNullPosition();
+        m_digitStartPositionRaw = m_positionRaw; // Zero for the next digit, no bus access
         m_lastCodeElement     = 0;
         m_currentCodeElement  = 0;
         m_currentDigit++;
@@ -19,6 +19,7 @@ private:
   static const uint8_t NUMBER_OF_CODE_DISK_ELEMENTS = 10;               /// Elements of the physical code disk, 0 ... 9
   static constexpr float STEP_SIZE = 360.0 / NUMBER_OF_CODE_DISK_ELEMENTS;
   static constexpr float TOLERANCE = STEP_SIZE/2.0 - STEP_SIZE*0.1; // 10 % of step size
+  static constexpr uint32_t TOLERANCE_RAW = angleDegToRaw(TOLERANCE); /// Tolerance in raw counts
 
   // Secret PWD
   static const uint8_t FIRST_CODE_ELEMENT        = 1;    /// Secret code, first digit
@@ -52,8 +53,10 @@ private:
   stm_bool_t             stm_exitFlag;    /// Flag for handling the exit action
 
   uint8_t m_errorCode;
-  float m_angleDeg;
-  float m_currentCodeElementAngle;
+  uint32_t m_angleRaw;                  /// Angle relative to the start of the current digit, raw counts
+  int64_t m_positionRaw;                /// Multi-turn position, raw counts
+  int64_t m_digitStartPositionRaw;      /// Multi-turn position at the start of the current digit
+  uint32_t m_currentCodeElementAngleRaw;
   uint8_t m_currentCode[NUMBER_OF_CODE_ELEMENTS];
   uint8_t m_correctCode[NUMBER_OF_CODE_ELEMENTS];
   uint8_t m_currentCodeElement;
@@ -1,28 +1,330 @@
+// ****************************************************************************
+/// \file      SerialHandler.hpp
+///
+/// \brief     Handels UART or RS485 interface
+///
+/// \details   BasicSerialHandler is bound at compile time to a port (SerialPort.hpp,
+///            sim/HostPorts.hpp) and a direction control (Rs485Direction or
+///            UartDirection), so the write and read paths are inlined and do not
+///            check the mode per byte. SerialHandler is the instance of the build,
+///            selected below from config.hpp or the compiler flags of a host build;
+///            the encoder stack only uses SerialHandler.
+///            Received bytes are moved from the port into an own ring buffer. The
+///            frame parser scans them in place and hands out frames as views into
+///            the ring, a frame is released once it is decoded. Bytes lost in front
+///            of the ring (receive buffer of the port full) or in the ring are counted.
+///
+/// \author    Christoph Capiaghi
+///
+/// \version   0.1
+///
+/// \date      20220802
+///
+/// \copyright Licensed under the Apache License, Version 2.0 (the "License");
+/// you may not use this file except in compliance with the License.
+/// You may obtain a copy of the License at
+/// http://www.apache.org/licenses/LICENSE-2.0
+///
+/// \pre
+///
+/// \bug
+///
+/// \warning   Header only, except the Uart object of ENCODER_SERCOM_UART
+///
+/// \todo      Polarisation?
+///
+
+// Prevent recursive inclusion
 #pragma once
 
 #include <stdint.h>
+#include <stddef.h>
+#include <arduino.h>
+#include "config.hpp"
+#include "BusCapture.hpp"
+#include "Rs485Direction.hpp"
+#include "SerialPort.hpp"
+#if defined(ENCODER_TERMIOS_PORT) || defined(ENCODER_MEMORY_PORT)
+#include "sim/HostPorts.hpp"
+#endif
 
-class SerialHandler
+template<class Port, class Direction>
+class BasicSerialHandler
 {
 public:
+    static const uint16_t RX_RING_SIZE        = 256;   /// Power of two, several replies
+    static const uint8_t  RX_MAX_VIEW_LENGTH  = 48;    /// Longest contiguous view, one Romer frame
+    static const uint32_t READ_TIMEOUT_MS     = 1000;  /// readBytes(), same as Stream
+
+    static_assert((RX_RING_SIZE & (RX_RING_SIZE - 1)) == 0, "RX ring size must be a power of two");
+
+    BasicSerialHandler() : m_baudrate(ENCODER_UART_SPEED),
+      m_charTimeUs(0),
+      m_txEndUs(0),
+      m_capture(0),
+      m_direction(),
+      m_rxHead(0),
+      m_rxTail(0),
+      m_rxOverrunCount(0),
+      m_rxDroppedCount(0)
+    {
+    }
+
+    /// <summary>
+    /// Starts the port at ENCODER_UART_SPEED, the RS-485 transceiver listens
+    /// </summary>
+    /// <returns>RC_Type</returns>
+    uint8_t initialize()
+    {
+        m_direction.initialize(TX_ENABLE_PIN);
+        m_baudrate = ENCODER_UART_SPEED;
+        setCharTime(SERIAL_8N1);
+        Port::begin(m_baudrate, SERIAL_8N1); // Default, no parity
+#ifdef DEBUG
+        Serial.println("SerialHandler init");
+#endif
+        return RC_OK;
+    }
+
+    /// <summary>
+    /// Config of UART and start
+    /// </summary>
+    void begin(unsigned long baudrate, uint16_t config)
+    {
+        m_baudrate = baudrate;
+        setCharTime(config);
+        Port::begin(baudrate, config);
+        if (m_capture) m_capture->recordConfig(baudrate, config);
+    }
+
+    void begin(unsigned long baudrate)
+    {
+        begin(baudrate, SERIAL_8N1);
+    }
+
+    void end()
+    {
+        Port::end();
+    }
+
+    /// <summary>
+    /// Baud rate of the last begin()
+    /// </summary>
+    unsigned long getBaudrate()
+    {
+        return m_baudrate;
+    }
+
+    /// <summary>
+    /// End of the last write(), which does not wait for the transmission. Expected
+    /// from the baud rate, may be in the future.
+    /// </summary>
+    /// <returns>micros() time the last stop bit is out</returns>
+    uint32_t getTxEndUs()
+    {
+        return m_txEndUs;
+    }
+
+    /// <summary>
+    /// Record the link traffic: every byte written and read and every begin() goes
+    /// into capture, while it is started. See BusCapture.cpp for the log format.
+    /// </summary>
+    void setCapture(BusCapture* capture)
+    {
+        m_capture = capture;
+    }
+
+    /// <summary>
+    /// Number of received bytes. Moves the bytes waiting in the port into the ring first.
+    /// </summary>
+    /// <returns>Bytes in the ring, released frames not counted</returns>
+    uint16_t available()
+    {
+        receive();
+        return (uint16_t)(m_rxHead - m_rxTail);
+    }
+
+    /// <summary>
+    /// Ring position of the oldest byte. Free running, identifies a byte for releaseRx().
+    /// </summary>
+    uint16_t getRxPosition()
+    {
+        return m_rxTail;
+    }
+
+    /// <summary>
+    /// Received byte, not removed. offset: 0 ... available() - 1 from the oldest byte
+    /// </summary>
+    uint8_t peekRx(const uint16_t offset)
+    {
+        return m_rxRing[(uint16_t)(m_rxTail + offset) & (RX_RING_SIZE - 1)];
+    }
 
-    SerialHandler();
-    uint8_t initialize();
-    uint8_t write(const uint8_t);
-    uint8_t write(const uint8_t txData[], uint8_t txDataLength);
-    uint8_t read();
-    size_t readBytes( uint8_t *buffer, size_t length);
-    void begin(unsigned long baudrate, uint16_t config);
-    void begin(unsigned long baudrate);
-    uint8_t available();
-
-    void end();
-    
-    void enableRs485Mode(void);
-    void disableRs485Mode(void);
-    
-private:   
-    uint8_t m_rs485ModeEnable;
-    void enableRx();
-    void enableTx();
+    /// <summary>
+    /// View of the received bytes from offset on, no copy. Contiguous for
+    /// RX_MAX_VIEW_LENGTH bytes, also across the end of the ring.
+    /// </summary>
+    /// <returns>Valid until the bytes are released</returns>
+    const uint8_t* getRxView(const uint16_t offset)
+    {
+        return &m_rxRing[(uint16_t)(m_rxTail + offset) & (RX_RING_SIZE - 1)];
+    }
+
+    /// <summary>
+    /// Release the oldest bytes, the ring reuses them. position: getRxPosition() of
+    /// the first byte. Nothing happens if these bytes are gone already, e.g. read()
+    /// by another transaction.
+    /// </summary>
+    void releaseRx(const uint16_t position, uint16_t count)
+    {
+        if (position != m_rxTail) return;
+        uint16_t used = m_rxHead - m_rxTail;
+        if (count > used) count = used;
+        m_rxTail += count;
+    }
+
+    uint32_t getRxOverrunCount()
+    {
+        return m_rxOverrunCount;
+    }
+
+    uint32_t getRxDroppedCount()
+    {
+        return m_rxDroppedCount;
+    }
+
+    /// <summary>
+    /// Wait until all data is sent: returns when the last stop bit is out, the
+    /// RS-485 driver is off
+    /// </summary>
+    void flush()
+    {
+        Port::flush();
+        m_direction.enableReceive();
+    }
+
+    /// <summary>
+    /// Write data over UART or RS485. Returns as soon as the data is queued. RS485:
+    /// the driver is on until the transmitter reports the last stop bit out, see
+    /// Rs485Direction
+    /// </summary>
+    /// <returns>Number of bytes written</returns>
+    uint8_t write(const uint8_t txData)
+    {
+        return write(&txData, 1);
+    }
+
+    uint8_t write(const uint8_t txData[], uint8_t txDataLength)
+    {
+        if (m_capture) m_capture->recordTx(txData, txDataLength);
+#ifdef DEBUG_VERBOSE
+        Serial.println(F("Serial 1 write: "));
+        for (uint8_t i = 0; i < txDataLength; i++)
+        {
+            Serial.println(txData[i]);
+        }
+        Serial.println("-------");
+#endif
+        uint32_t nowUs = micros();
+        if ((int32_t)(nowUs - m_txEndUs) > 0) m_txEndUs = nowUs; // Line idle
+        m_txEndUs += txDataLength * m_charTimeUs;
+
+        m_direction.enableTransmit();
+        uint8_t txDataWritten = (uint8_t)Port::write(txData, txDataLength);
+        m_direction.releaseAt(m_txEndUs, m_charTimeUs);
+        return txDataWritten;
+    }
+
+    /// <summary>
+    /// Read data over UART or RS485
+    /// </summary>
+    /// <returns>Oldest byte of the ring, 0xFF if none</returns>
+    uint8_t read()
+    {
+        if (available() == 0) return 0xFF;
+        uint8_t rxData = peekRx(0);
+        m_rxTail++;
+        return rxData;
+    }
+
+    /// <summary>
+    /// Read Bytes from the ring, waits up to READ_TIMEOUT_MS for each byte like Stream
+    /// </summary>
+    /// <param name="buffer">Buffer for data storage</param>
+    /// <param name="length">Length of the buffer</param>
+    /// <returns>Number of bytes read</returns>
+    size_t readBytes(uint8_t *buffer, const size_t length)
+    {
+        size_t rxDataLength = 0;
+        uint32_t startMs = millis();
+        while (rxDataLength < length && (millis() - startMs) < READ_TIMEOUT_MS)
+        {
+            if (available() == 0) continue;
+            buffer[rxDataLength++] = read();
+            startMs = millis();
+        }
+        return rxDataLength;
+    }
+
+private:
+    unsigned long m_baudrate;   /// Current baud rate of the port
+    uint32_t m_charTimeUs;      /// One character on the line at m_baudrate
+    uint32_t m_txEndUs;         /// Expected end of the last stop bit written
+    BusCapture* m_capture;      /// Records the link traffic, 0: off
+    Direction m_direction;      /// Driver enable of the transceiver, nothing for a plain UART
+    uint8_t  m_rxRing[RX_RING_SIZE + RX_MAX_VIEW_LENGTH]; /// The first bytes are repeated behind the end: views never wrap
+    uint16_t m_rxHead;          /// Free running positions, masked with RX_RING_SIZE - 1
+    uint16_t m_rxTail;          /// Oldest byte not released
+    uint32_t m_rxOverrunCount;  /// Receive buffer of the port found full: bytes lost before the ring
+    uint32_t m_rxDroppedCount;  /// Bytes lost, ring full
+
+    /// <summary>
+    /// Time of one character: start bit, 8 data bits, parity bit if any, stop bit
+    /// </summary>
+    void setCharTime(uint16_t config)
+    {
+        uint8_t bits = (config == SERIAL_8N1) ? 10 : 11;
+        m_charTimeUs = (bits * 1000000UL + m_baudrate - 1) / m_baudrate;
+    }
+
+    /// <summary>
+    /// Moves the bytes waiting in the port into the ring. The first RX_MAX_VIEW_LENGTH
+    /// bytes of the ring are also written behind its end, so a view starting near the
+    /// end continues there.
+    /// </summary>
+    void receive()
+    {
+        int pending = Port::available();
+        if (pending >= Port::RX_BUFFER_SIZE - 1) m_rxOverrunCount++; // Full, the port dropped what came next
+        while (pending-- > 0)
+        {
+            int rxData = Port::read();
+            if (rxData < 0) break;
+            if (m_capture) m_capture->recordRx((uint8_t)rxData);
+            if ((uint16_t)(m_rxHead - m_rxTail) >= RX_RING_SIZE)
+            {
+                m_rxDroppedCount++;
+                continue;
+            }
+            uint16_t index = m_rxHead & (RX_RING_SIZE - 1);
+            m_rxRing[index] = (uint8_t)rxData;
+            if (index < RX_MAX_VIEW_LENGTH) m_rxRing[RX_RING_SIZE + index] = (uint8_t)rxData;
+            m_rxHead++;
+        }
+    }
 };
+
+// Port and direction control of the encoder link
+#if defined(ENCODER_TERMIOS_PORT)
+typedef BasicSerialHandler<TermiosPort, UartDirection> SerialHandler;      // Linux: the adapter switches RS-485 itself
+#elif defined(ENCODER_MEMORY_PORT)
+typedef BasicSerialHandler<MemoryPort, UartDirection> SerialHandler;
+#elif defined(ENCODER_SERCOM_UART) && defined(ENCODER_RS485)
+typedef BasicSerialHandler<SercomPort, Rs485Direction> SerialHandler;
+#elif defined(ENCODER_SERCOM_UART)
+typedef BasicSerialHandler<SercomPort, UartDirection> SerialHandler;
+#elif defined(ENCODER_RS485)
+typedef BasicSerialHandler<Serial1Port, Rs485Direction> SerialHandler;
+#else
+typedef BasicSerialHandler<Serial1Port, UartDirection> SerialHandler;
+#endif
@@ -0,0 +1,116 @@
+// ****************************************************************************
+/// \file      SerialPort.hpp
+///
+/// \brief     Port policies of the SerialHandler: the UART of the encoder link
+///
+/// \details   A port policy is a class with static members only, bound to the
+///            SerialHandler at compile time, so every call is inlined:
+///              begin(baudrate, config), end(), available(), read(),
+///              write(data, length), flush() and RX_BUFFER_SIZE, the receive
+///              buffer in front of the SerialHandler (overrun detection).
+///            UartPort binds a Uart object of the core: Serial1 (SERCOM1 on the
+///            MatrixPortal M4) or an own Uart on another SERCOM, see
+///            ENCODER_SERCOM_UART in config.hpp. The host ports (Linux serial
+///            device or pty, in memory) are in sim/HostPorts.hpp.
+///
+/// \author    Christoph Capiaghi
+///
+/// \version   0.1
+///
+/// \date      20221017
+///
+/// \copyright Licensed under the Apache License, Version 2.0 (the "License");
+/// you may not use this file except in compliance with the License.
+/// You may obtain a copy of the License at
+/// http://www.apache.org/licenses/LICENSE-2.0
+///
+/// \pre
+///
+/// \bug
+///
+/// \warning   The TX complete flag of the RS-485 direction control is read from
+///            ENCODER_UART_SERCOM: it must be the SERCOM of the bound Uart
+///
+/// \todo
+///
+
+// Prevent recursive inclusion
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <arduino.h>
+#include "config.hpp"
+
+#if defined(SERIAL_BUFFER_SIZE)
+static const uint16_t CORE_SERIAL_BUFFER_SIZE = SERIAL_BUFFER_SIZE;   /// Receive buffer of a Uart of the core
+#else
+static const uint16_t CORE_SERIAL_BUFFER_SIZE = 64;
+#endif
+
+template<class Uart, Uart& Device>
+class UartPort
+{
+public:
+    static const uint16_t RX_BUFFER_SIZE = CORE_SERIAL_BUFFER_SIZE;
+
+    static void begin(const unsigned long baudrate, const uint16_t config)
+    {
+        Device.begin(baudrate, config);
+        while (!Device);
+    }
+
+    static void end()
+    {
+        Device.end();
+    }
+
+    static int available()
+    {
+        return Device.available();
+    }
+
+    /// <summary>
+    /// Oldest byte of the receive buffer
+    /// </summary>
+    /// <returns>-1 if empty</returns>
+    static int read()
+    {
+        return Device.read();
+    }
+
+    /// <summary>
+    /// Queues the bytes, waits only if the transmit buffer is full
+    /// </summary>
+    static size_t write(const uint8_t data[], const size_t length)
+    {
+        return Device.write(data, length);
+    }
+
+    /// <summary>
+    /// Returns when the last stop bit is out
+    /// </summary>
+    static void flush()
+    {
+        Device.flush();
+    }
+};
+
+/// \brief Serial1 of the board
+typedef UartPort<decltype(Serial1), Serial1> Serial1Port;
+
+#if defined(ENCODER_SERCOM_UART)
+extern Uart EncoderUart;        /// Defined in SerialHandler.cpp, pins and SERCOM in config.hpp
+void connectEncoderUartPins();
+
+/// \brief Own Uart on another SERCOM, the pins are switched to it after begin()
+class SercomPort : public UartPort<Uart, EncoderUart>
+{
+public:
+    static void begin(const unsigned long baudrate, const uint16_t config)
+    {
+        UartPort<Uart, EncoderUart>::begin(baudrate, config);
+        connectEncoderUartPins();
+    }
+};
+#endif
@@ -0,0 +1,101 @@
+// ****************************************************************************
+/// \file      SpscQueue.hpp
+///
+/// \brief     Wait-free single-producer / single-consumer ring buffer
+///
+/// \details   One side (e.g. an interrupt) pushes, the other side (loop) pops.
+///            Each index is written by one side only, so neither side ever waits
+///            or disables interrupts. The indices run freely modulo 2^16, the
+///            size must be a power of two. A full queue rejects the new item,
+///            the producer counts the loss.
+///
+/// \author    Christoph Capiaghi
+///
+/// \version   0.1
+///
+/// \date      20221017
+///
+/// \copyright Licensed under the Apache License, Version 2.0 (the "License");
+/// you may not use this file except in compliance with the License.
+/// You may obtain a copy of the License at
+/// http://www.apache.org/licenses/LICENSE-2.0
+///
+/// \pre
+///
+/// \bug
+///
+/// \warning   One producer and one consumer only. 16 bit index loads and stores
+///            are atomic on the Cortex-M4.
+///
+/// \todo
+///
+
+// Prevent recursive inclusion
+#pragma once
+
+#include <stdint.h>
+
+template<class T, uint16_t Size>
+class SpscQueue
+{
+public:
+    static_assert(Size >= 2 && (Size & (Size - 1)) == 0, "Size must be a power of two");
+    static const uint16_t SIZE = Size;
+
+    SpscQueue() : m_head(0), m_tail(0) {}
+
+    /// <summary>
+    /// Producer: append an item
+    /// </summary>
+    /// <returns>false if the queue is full, the item is dropped</returns>
+    bool push(const T& item)
+    {
+        uint16_t head = m_head;
+        if ((uint16_t)(head - m_tail) == Size) return false;
+        m_items[head & (Size - 1)] = item;
+        __sync_synchronize(); // Item complete before the consumer can see it
+        m_head = head + 1;
+        return true;
+    }
+
+    /// <summary>
+    /// Consumer: take the oldest item
+    /// </summary>
+    /// <returns>false if the queue is empty</returns>
+    bool pop(T& item)
+    {
+        uint16_t tail = m_tail;
+        if (tail == m_head) return false;
+        __sync_synchronize(); // Index read before the item
+        item = m_items[tail & (Size - 1)];
+        __sync_synchronize(); // Item read before the slot is given back
+        m_tail = tail + 1;
+        return true;
+    }
+
+    /// <summary>
+    /// Number of items, exact for the consumer, a lower bound for the producer
+    /// </summary>
+    uint16_t size()
+    {
+        return (uint16_t)(m_head - m_tail);
+    }
+
+    bool empty()
+    {
+        return m_head == m_tail;
+    }
+
+    /// <summary>
+    /// Consumer: drop all items
+    /// </summary>
+    void clear()
+    {
+        m_tail = m_head;
+    }
+
+private:
+    T m_items[Size];
+    volatile uint16_t m_head;   /// Next slot to write, producer only
+    volatile uint16_t m_tail;   /// Next slot to read, consumer only
+};
@@ -0,0 +1,192 @@
+// ****************************************************************************
+/// \file      TriggerScheduler.cpp
+///
+/// \brief     Schedule of the hardware trigger pulses
+///
+/// \details   The encoder latches its angle on the rising edge of the trigger
+///            input, the angle is read out afterwards with a B command. This class
+///            only decides when a pulse is due: a fixed period, optionally
+///            phase-locked to the display frame so every frame gets a sample taken
+///            a fixed lead time before it starts. No hardware access, the caller
+///            (EncoderSampler on the timer interrupt, encoder_sim on the host)
+///            drives the pin and passes the edge time back.
+///
+/// \author    Christoph Capiaghi
+///
+/// \version   0.1
+///
+/// \date      20221017
+///
+/// \copyright Licensed under the Apache License, Version 2.0 (the "License");
+/// you may not use this file except in compliance with the License.
+/// You may obtain a copy of the License at
+/// http://www.apache.org/licenses/LICENSE-2.0
+///
+/// \pre
+///
+/// \bug
+///
+/// \warning   Pulses are checked on the caller's tick: the pulse period should be
+///            a multiple of the tick period, else the edges jitter by one tick
+///            (the timestamps stay exact, they are taken at the edge).
+///
+/// \todo
+///
+
+#include "TriggerScheduler.hpp"
+#include "config.hpp"
+
+TriggerScheduler::TriggerScheduler() : m_periodUs(1000),
+  m_nextPulseUs(0),
+  m_phaseCorrectionUs(0),
+  m_lockTargetUs(0),
+  m_lockPending(false),
+  m_phaseErrorUs(0),
+  m_pulseCount(0),
+  m_skippedCount(0),
+  m_maxLatenessUs(0)
+{
+
+}
+
+// ----------------------------------------------------------------------------
+/// \brief     Initialize schedule
+/// \detail    First pulse at startUs, then every periodUs
+/// \warning
+/// \return    RC_Type
+/// \todo
+///
+uint8_t TriggerScheduler::initialize(const uint32_t periodUs, const uint32_t startUs)
+{
+  if (periodUs < MIN_PERIOD_US) return RC_INV_PARAM;
+  m_periodUs          = periodUs;
+  m_nextPulseUs       = startUs;
+  m_phaseCorrectionUs = 0;
+  m_lockPending       = false;
+  m_phaseErrorUs      = 0;
+  m_pulseCount        = 0;
+  m_skippedCount      = 0;
+  m_maxLatenessUs     = 0;
+  return RC_OK;
+}
+
+// ----------------------------------------------------------------------------
+/// \brief     Is the next pulse due?
+/// \detail
+/// \warning
+/// \return    true if nowUs reached the scheduled time
+/// \todo
+///
+bool TriggerScheduler::isPulseDue(const uint32_t nowUs)
+{
+  return (int32_t)(nowUs - m_nextPulseUs) >= 0;
+}
+
+// ----------------------------------------------------------------------------
+/// \brief     A pulse was sent
+/// \detail    Advances the schedule. A pulse more than one period late (e.g. the
+///            caller was blocked) does not cause a burst of catch-up pulses.
+/// \warning
+/// \return    edgeUs, the latch time of the encoder
+/// \todo
+///
+uint32_t TriggerScheduler::firePulse(const uint32_t edgeUs)
+{
+  uint32_t latenessUs = edgeUs - m_nextPulseUs;
+  if ((int32_t)latenessUs > 0 && latenessUs > m_maxLatenessUs) m_maxLatenessUs = latenessUs;
+  m_pulseCount++;
+  advance();
+  while ((int32_t)(edgeUs - m_nextPulseUs) >= 0) advance();
+  return edgeUs;
+}
+
+// ----------------------------------------------------------------------------
+/// \brief     The due pulse is not sent
+/// \detail    E.g. the readout of the last pulse is still on the bus
+/// \warning
+/// \return
+/// \todo
+///
+void TriggerScheduler::skipPulse()
+{
+  m_skippedCount++;
+  advance();
+}
+
+// ----------------------------------------------------------------------------
+/// \brief     Phase-lock the pulses to the display frame
+/// \detail    Call at the start of every frame. The pulse grid is pulled towards
+///            frameStartUs - leadUs by at most MAX_PHASE_STEP_US per pulse.
+///            The frame period should be a multiple of the pulse period.
+/// \warning   Main loop. Only posts the target instant: the interrupt owns the
+///            schedule and computes the phase error with the next pulse.
+/// \return
+/// \todo
+///
+void TriggerScheduler::lockToFrame(const uint32_t frameStartUs, const uint32_t leadUs)
+{
+  m_lockTargetUs = frameStartUs - leadUs; // Single word, written before the flag
+  m_lockPending  = true;
+}
+
+uint32_t TriggerScheduler::getPeriodUs()
+{
+  return m_periodUs;
+}
+
+uint32_t TriggerScheduler::getNextPulseUs()
+{
+  return m_nextPulseUs;
+}
+
+// ----------------------------------------------------------------------------
+/// \brief     Get phase error of the last lockToFrame()
+/// \detail    Target instant minus pulse grid
+/// \warning
+/// \return    Microseconds, 0: locked
+/// \todo
+///
+int32_t TriggerScheduler::getPhaseErrorUs()
+{
+  return m_phaseErrorUs;
+}
+
+uint32_t TriggerScheduler::getPulseCount()
+{
+  return m_pulseCount;
+}
+
+uint32_t TriggerScheduler::getSkippedCount()
+{
+  return m_skippedCount;
+}
+
+uint32_t TriggerScheduler::getMaxLatenessUs()
+{
+  return m_maxLatenessUs;
+}
+
+/// <summary>
+/// Next pulse one period later, plus a limited share of the pending phase correction.
+/// A target posted by lockToFrame() replaces the pending correction.
+/// </summary>
+void TriggerScheduler::advance()
+{
+  if (m_lockPending)
+  {
+    m_lockPending = false;
+    // Offset of the target instant to the pulse grid, -period/2 ... +period/2
+    int32_t period  = (int32_t)m_periodUs;
+    int32_t errorUs = (int32_t)(m_lockTargetUs - m_nextPulseUs) % period;
+    if (errorUs >  period / 2) errorUs -= period;
+    if (errorUs < -period / 2) errorUs += period;
+    m_phaseErrorUs      = errorUs;
+    m_phaseCorrectionUs = errorUs;
+  }
+
+  int32_t correctionUs = m_phaseCorrectionUs;
+  if (correctionUs >  (int32_t)MAX_PHASE_STEP_US) correctionUs =  (int32_t)MAX_PHASE_STEP_US;
+  if (correctionUs < -(int32_t)MAX_PHASE_STEP_US) correctionUs = -(int32_t)MAX_PHASE_STEP_US;
+  m_phaseCorrectionUs -= correctionUs;
+  m_nextPulseUs += m_periodUs + correctionUs;
+}
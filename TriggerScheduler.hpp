@@ -0,0 +1,36 @@
+#pragma once
+
+#include <stdint.h>
+
+class TriggerScheduler
+{
+public:
+    static const uint32_t MIN_PERIOD_US       = 200;
+    static const uint32_t MAX_PHASE_STEP_US   = 50;    /// Largest phase correction per pulse, keeps the sample spacing smooth
+
+    TriggerScheduler();
+    uint8_t initialize(const uint32_t periodUs, const uint32_t startUs);
+    bool isPulseDue(const uint32_t nowUs);
+    uint32_t firePulse(const uint32_t edgeUs);
+    void skipPulse();
+    void lockToFrame(const uint32_t frameStartUs, const uint32_t leadUs);
+    uint32_t getPeriodUs();
+    uint32_t getNextPulseUs();
+    int32_t getPhaseErrorUs();
+    uint32_t getPulseCount();
+    uint32_t getSkippedCount();
+    uint32_t getMaxLatenessUs();
+
+private:
+    uint32_t m_periodUs;
+    uint32_t m_nextPulseUs;                  /// Scheduled time of the next pulse, interrupt only once running
+    int32_t m_phaseCorrectionUs;             /// Pending phase correction, interrupt only
+    volatile uint32_t m_lockTargetUs;        /// Posted by lockToFrame(): instant the pulse grid should hit
+    volatile bool m_lockPending;             /// m_lockTargetUs not applied yet
+    volatile int32_t m_phaseErrorUs;         /// Last measured offset of the pulse grid to the frame
+    volatile uint32_t m_pulseCount;
+    volatile uint32_t m_skippedCount;        /// Pulses not sent: readout of the last one still running
+    volatile uint32_t m_maxLatenessUs;       /// Largest delay of a pulse behind its schedule
+
+    void advance();
+};
@@ -0,0 +1,187 @@
+// ****************************************************************************
+/// \file      TurnTracker.cpp
+///
+/// \brief     Multi-turn position from successive raw angles
+///
+/// \details   Unwraps the raw encoder angle (2^32 counts per revolution) into a
+///            continuous 64 bit position: the shortest signed difference to the
+///            previous sample is accumulated. Turns, direction and speed are then
+///            available in O(1), no bus access and no re-zeroing needed.
+///
+/// \author    Christoph Capiaghi
+///
+/// \version   0.1
+///
+/// \date      20221017
+///
+/// \copyright Licensed under the Apache License, Version 2.0 (the "License");
+/// you may not use this file except in compliance with the License.
+/// You may obtain a copy of the License at
+/// http://www.apache.org/licenses/LICENSE-2.0
+///
+/// \pre       
+///
+/// \bug       
+///
+/// \warning   The knob must turn less than 180 degree between two samples
+///            (more than 60000 degree per second at 350 samples per second)
+///
+/// \todo      
+///
+
+#include "TurnTracker.hpp"
+#include "Angle.hpp"
+
+TurnTracker::TurnTracker() : m_position(0),
+  m_lastAngle(0),
+  m_timestampUs(0),
+  m_delta(0),
+  m_velocity(0.0f),
+  m_extremePosition(0),
+  m_direction(0),
+  m_valid(false)
+{
+
+}
+
+// ----------------------------------------------------------------------------
+/// \brief     Reset tracker
+/// \detail    The next sample starts at turn 0
+/// \warning   
+/// \return    
+/// \todo      
+///
+void TurnTracker::reset()
+{
+  m_delta     = 0;
+  m_velocity  = 0.0f;
+  m_direction = 0;
+  m_valid     = false;
+}
+
+// ----------------------------------------------------------------------------
+/// \brief     Feed a new sample
+/// \detail    Every sample should be fed, also those of a batch: a gap of more
+///            than half a revolution is unwrapped the wrong way
+/// \warning   
+/// \return    
+/// \todo      
+///
+void TurnTracker::update(const uint32_t rawAngle, const uint32_t timestampUs)
+{
+  if (!m_valid)
+  {
+    m_position        = rawAngle;
+    m_extremePosition = m_position;
+    m_lastAngle       = rawAngle;
+    m_timestampUs     = timestampUs;
+    m_valid           = true;
+    return;
+  }
+
+  uint32_t dtUs = timestampUs - m_timestampUs;
+  m_delta       = angleRawDifference(rawAngle, m_lastAngle);
+  m_position   += m_delta;
+  m_velocity    = (dtUs > 0) ? (float)m_delta / (float)dtUs : 0.0f;
+  m_lastAngle   = rawAngle;
+  m_timestampUs = timestampUs;
+
+  // Direction with hysteresis: follow the extreme, turn after DIRECTION_DEADBAND_RAW back
+  if (m_direction > 0 && m_position > m_extremePosition) m_extremePosition = m_position;
+  if (m_direction < 0 && m_position < m_extremePosition) m_extremePosition = m_position;
+  if (m_position - m_extremePosition > (int64_t)DIRECTION_DEADBAND_RAW)
+  {
+    m_direction       = 1;
+    m_extremePosition = m_position;
+  }
+  else if (m_extremePosition - m_position > (int64_t)DIRECTION_DEADBAND_RAW)
+  {
+    m_direction       = -1;
+    m_extremePosition = m_position;
+  }
+}
+
+// ----------------------------------------------------------------------------
+/// \brief     Get unwrapped position
+/// \detail    Raw counts since the first sample plus its raw angle,
+///            2^32 counts per revolution
+/// \warning   
+/// \return    Position in raw counts
+/// \todo      
+///
+int64_t TurnTracker::getPosition()
+{
+  return m_position;
+}
+
+// ----------------------------------------------------------------------------
+/// \brief     Get number of full turns
+/// \detail    Rounded towards minus infinity, e.g. -1 just below 0 degree
+/// \warning   
+/// \return    Turns
+/// \todo      
+///
+int32_t TurnTracker::getTurns()
+{
+  return (int32_t)(m_position >> 32);
+}
+
+// ----------------------------------------------------------------------------
+/// \brief     Get angle within the current turn
+/// \detail    Same as the raw angle of the last sample
+/// \warning   
+/// \return    Raw angle
+/// \todo      
+///
+uint32_t TurnTracker::getAngle()
+{
+  return (uint32_t)m_position;
+}
+
+// ----------------------------------------------------------------------------
+/// \brief     Get motion of the last sample
+/// \detail    
+/// \warning   
+/// \return    Signed difference to the previous sample, raw counts
+/// \todo      
+///
+int32_t TurnTracker::getDelta()
+{
+  return m_delta;
+}
+
+// ----------------------------------------------------------------------------
+/// \brief     Get direction of rotation
+/// \detail    Changes only after DIRECTION_DEADBAND_RAW in the opposite direction
+/// \warning   
+/// \return    +1: counting up, -1: counting down, 0: not moved yet
+/// \todo      
+///
+int8_t TurnTracker::getDirection()
+{
+  return m_direction;
+}
+
+// ----------------------------------------------------------------------------
+/// \brief     Get speed of the last sample
+/// \detail    Unfiltered, see AngleEstimator for a smoothed velocity
+/// \warning   
+/// \return    Raw counts per microsecond, positive: counting up
+/// \todo      
+///
+float TurnTracker::getVelocity()
+{
+  return m_velocity;
+}
+
+// ----------------------------------------------------------------------------
+/// \brief     Position valid?
+/// \detail    
+/// \warning   
+/// \return    true after the first sample
+/// \todo      
+///
+bool TurnTracker::isValid()
+{
+  return m_valid;
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <stdint.h>
+
+class TurnTracker
+{
+public:
+
+    TurnTracker();
+    void reset();
+    void update(const uint32_t rawAngle, const uint32_t timestampUs);
+    int64_t getPosition();
+    int32_t getTurns();
+    uint32_t getAngle();
+    int32_t getDelta();
+    int8_t getDirection();
+    float getVelocity();
+    bool isValid();
+
+private:
+    static const uint32_t DIRECTION_DEADBAND_RAW = 0x00100000; /// About 0.09 degree, noise does not flip the direction
+
+    int64_t  m_position;      /// Unwrapped angle, raw counts, 2^32 per revolution
+    uint32_t m_lastAngle;     /// Raw angle of the last sample
+    uint32_t m_timestampUs;   /// Time of the last sample
+    int32_t  m_delta;         /// Signed motion of the last sample, raw counts
+    float    m_velocity;      /// Motion of the last sample, raw counts per microsecond
+    int64_t  m_extremePosition; /// Furthest position in the current direction
+    int8_t   m_direction;     /// +1: counting up, -1: counting down, 0: not moved yet
+    bool     m_valid;         /// At least one sample seen
+};
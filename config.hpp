@@ -42,8 +42,36 @@
 
 #define SHOW_HTC
 
-#define UART_SPEED		( 230400 )
+#define ENCODER_PIPELINED      // Trigger the next angle as soon as the last reply is in
+#define ANGLE_FILTER_WINDOW    ( 16 )  // Encoder samples per judgement of the accuracy game, 1: single sample
+#define ANGLE_SERVICE_PERIOD_US ( 0 )  // Min. time between two angle reads of the main loop, 0: one read per loop tick
+//#define ENCODER_TIMER_SAMPLING_US ( 1000 ) // Encoder driven by timer TC3 at this period instead of loop(). Needs DEBUG off
+//#define ENCODER_HARDWARE_TRIGGER_US ( 1000 ) // Encoder latches on TRIGGER_PIN pulses at this period. Needs ENCODER_TIMER_SAMPLING_US, e.g. 250
+//#define ENCODER_CAPTURE_BYTES ( 16384 ) // Record the encoder link into RAM, dump with 'c' on the debug port
+
+#define ENCODER_RS485                 // Encoder link over the RS-485 transceiver, driver enable on TX_ENABLE_PIN. Off: plain UART
+//#define ENCODER_SERCOM_UART           // Encoder link on an own Uart (ENCODER_UART_* below) instead of Serial1
+// Host builds select their port with -DENCODER_TERMIOS_PORT or -DENCODER_MEMORY_PORT, see sim/README.md
+
+#define UART_SPEED		( 230400 )  // Debug port (Serial)
+#define ENCODER_UART_SPEED     ( 230400 )  // Encoder link (Serial1) after power-up
+#define ENCODER_UART_SPEED_MAX ( 921600 )  // Highest rate tried by the baud rate negotiation
+
+//#define ENCODER_HIGH_SPEED_LINK       // Negotiate the highest working baud rate with the encoder
+#define ENCODER_BAUDRATE_REGISTER ( 0x0010 ) // HA40+ register holding the baud rate in bit/s. Check against the HA40+ manual
+#define ENCODER_TRIGGER_MODE_REGISTER ( 0x0011 ) // HA40+ register, 1: latch on the trigger input. Check against the HA40+ manual
 #define DEBUG			          // Serial Debug enable
+//#define DEBUG_VERBOSE         // Per transaction debug output (TX bytes, raw angles), limits the sample rate. Needs DEBUG
+
+#if defined(ENCODER_TIMER_SAMPLING_US) && defined(DEBUG)
+#error "ENCODER_TIMER_SAMPLING_US needs DEBUG off: the encoder classes would print to Serial in the TC3 interrupt"
+#endif
+#if defined(DEBUG_VERBOSE) && !defined(DEBUG)
+#error "DEBUG_VERBOSE needs DEBUG"
+#endif
+#if defined(ENCODER_HARDWARE_TRIGGER_US) && !defined(ENCODER_TIMER_SAMPLING_US)
+#error "ENCODER_HARDWARE_TRIGGER_US needs ENCODER_TIMER_SAMPLING_US"
+#endif
 
 #define HEIGHT			( 32 )  // Matrix height (pixels) - SET TO 64 FOR 64x64 MATRIX!
 #define WIDTH			  ( 32 )  // Matrix width (pixels)
@@ -67,6 +95,11 @@ const uint8_t RC_OK = 0;
 const uint8_t RC_INV_UART1_LENGTH = 1;
 const uint8_t RC_INV_UART1_COMMAND = 2;
 const uint8_t RC_INV_UART1_TIMEOUT = 3;
+const uint8_t RC_BUSY = 4;              /// Transaction still in progress, poll again
+const uint8_t RC_INV_UART1_CRC = 5;     /// Frame with invalid CRC8
+const uint8_t RC_INV_UART1_ADDRESS = 6; /// Reply from an unexpected slave
+const uint8_t RC_STALE = 7;             /// Encoder link down, last good sample returned
+const uint8_t RC_INV_PARAM = 8;         /// Parameter out of range
 
 
 const uint8_t INVALID_CODE        = 1;
@@ -78,23 +111,33 @@ const uint8_t INIT_COMPLETE       = 1;  /// Init not complete
 const char SOFTWARE_VERSION[10] = "V1.0";
 
 
-
-const uint8_t DELAY_US_PIN_STATE = 100; // Wait time after digitalWrite (SerialHandler)
-
 // Define Pins  ************************************************************
 
-// Pinout RGB Matrix
-static uint8_t rgbPins[] = { 7, 8, 9, 10, 11, 12 };
-static uint8_t addrPins[] = { 17, 18, 19, 20, 21 };
-static uint8_t clockPin = 14;
-static uint8_t latchPin = 15;
-static uint8_t oePin = 16;
+// Pinout RGB Matrix, only used by rgbSafe.ino (unused attribute: no warning in the other units)
+static uint8_t rgbPins[] __attribute__((unused)) = { 7, 8, 9, 10, 11, 12 };
+static uint8_t addrPins[] __attribute__((unused)) = { 17, 18, 19, 20, 21 };
+static uint8_t clockPin __attribute__((unused)) = 14;
+static uint8_t latchPin __attribute__((unused)) = 15;
+static uint8_t oePin __attribute__((unused)) = 16;
 
-//static const uint8_t TRIGGER_PIN = 23;   // A1
+#define TRIGGER_PIN         A0  // A0, trigger input of the encoder
 #define LOCK_PIN            A1  // A1
 #define BUTTON_ENTER_PIN    A2	// A2
 #define RGB_STRIP_PIN       A3 // A3
 #define TX_ENABLE_PIN       A4 // A4
+#ifdef ENCODER_SERCOM_UART
+// Example on the I2C pins (Wire unused): check SERCOM, pins and pads against variant.cpp of the board
+#define ENCODER_UART_SERCOM        SERCOM4       // Its TX complete flag ends RS-485 transmission
+#define ENCODER_UART_SERCOM_CORE   sercom4       // SERCOM object of the core
+#define ENCODER_UART_SERCOM_NUMBER 4             // Interrupt handlers SERCOM4_0_Handler ... SERCOM4_3_Handler
+#define ENCODER_UART_RX_PIN        PIN_WIRE_SCL  // Pad 1
+#define ENCODER_UART_TX_PIN        PIN_WIRE_SDA  // Pad 0
+#define ENCODER_UART_RX_PAD        SERCOM_RX_PAD_1
+#define ENCODER_UART_TX_PAD        UART_TX_PAD_0
+#define ENCODER_UART_PIN_FUNCTION  PIO_SERCOM_ALT
+#else
+#define ENCODER_UART_SERCOM SERCOM1 // SERCOM behind Serial1 (MatrixPortal M4), its TX complete flag ends RS-485 transmission
+#endif
 
 #define RGB_ONBOARD_LED_PIN       4 // A3
 
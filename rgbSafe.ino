@@ -81,6 +81,10 @@ SafeGame safeGame;              /// Safe simulation
 Safe safe;                      /// Safe itself
 ButtonHandler enterButton;      /// Button
 SerialHandler serialHandler;    /// Serial Interface to Encoder (RS-485)
+#ifdef ENCODER_CAPTURE_BYTES
+uint8_t captureBuffer[ENCODER_CAPTURE_BYTES]; /// Log of the encoder link
+BusCapture busCapture;          /// Records the encoder link for offline replay (sim/encoder_sim)
+#endif
 
 
 Timer<1, millis, Adafruit_NeoPixel *> rbgStripTimer; /// Timer: 1 concurrent tasks, using millis as resolution
@@ -102,7 +106,7 @@ void setup() {
   #ifdef DEBUG
 	Serial.begin(UART_SPEED);
   #endif
-	Serial1.begin(UART_SPEED);
+	Serial1.begin(ENCODER_UART_SPEED);
 
 	// Initialize rgb matrix
 	ProtomatterStatus status = matrix.begin();
@@ -118,7 +122,11 @@ void setup() {
 	matrix.show();
 
 	serialHandler.initialize();
-	serialHandler.enableRs485Mode();
+#ifdef ENCODER_CAPTURE_BYTES
+  busCapture.initialize(captureBuffer, sizeof(captureBuffer));
+  serialHandler.setCapture(&busCapture);
+  busCapture.start(serialHandler.getBaudrate()); // From the power-up of the encoder
+#endif
 
 	enterButton.initialize();
 
@@ -131,11 +139,14 @@ void setup() {
   onBoardNeoPixel.setPixelColor(0, onBoardNeoPixel.Color(0, 255, 0));
   onBoardNeoPixel.show(); // Initialize all pixels to 'off'
 
-  showHTCRules(); // Warning: This function takes approx. 4 s. Needed for Encoder startup
-
+  // The encoder is probed until it answers, no fixed power-on delay needed
   errorCode = safe.initialize(&matrix, &serialHandler, &neoPixels, &rbgStripTimer);
   if (errorCode != 0) errorHandler();
 
+#ifdef SHOW_HTC
+  showHTCRules(); // Warning: This function takes approx. 4 s
+#endif
+
   errorCode = safeGame.initialize(&safe);
   if (errorCode != 0) errorHandler();
   
@@ -157,10 +168,27 @@ void loop()
   // calculations are non-deterministic (don't always take the same amount
   // of time, depending on their current states), this helps ensure that
   // things constant in the simulation.
+  // The encoder keeps sampling while waiting for the next frame.
   uint32_t t;
-  while(((t = micros()) - prevTime) < (1000000L / MAX_FPS));
+  while(((t = micros()) - prevTime) < (1000000L / MAX_FPS))
+  {
+    safe.update();
+  }
   prevTime = t;
+  safe.tick(); // One angle read per frame, shared by both games
 
+#ifdef DEBUG
+  // Encoder link statistics on demand: send 's' on the debug port
+  // Capture of the encoder link since power-up: 'c' stops and dumps it (hex)
+  if (Serial.available() > 0)
+  {
+    int command = Serial.read();
+    if (command == 's') safe.printEncoderStats();
+#ifdef ENCODER_CAPTURE_BYTES
+    if (command == 'c') busCapture.dump();
+#endif
+  }
+#endif
   
 	// Check button state
 #ifndef NO_BUTTON
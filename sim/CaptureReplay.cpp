@@ -0,0 +1,185 @@
+// ****************************************************************************
+/// \file      CaptureReplay.cpp
+///
+/// \brief     Replays a BusCapture log in place of the encoder
+///
+/// \details   See CaptureReplay.hpp
+///
+/// \author    Christoph Capiaghi
+///
+/// \version   0.1
+///
+/// \date      20221017
+///
+/// \copyright Licensed under the Apache License, Version 2.0 (the "License");
+/// you may not use this file except in compliance with the License.
+/// You may obtain a copy of the License at
+/// http://www.apache.org/licenses/LICENSE-2.0
+///
+/// \pre
+///
+/// \bug
+///
+/// \warning
+///
+/// \todo
+///
+
+#include <stdint.h>
+#include "arduino.h"
+#include "CaptureReplay.hpp"
+#include "../config.hpp"
+
+CaptureReplay::CaptureReplay() : m_data(0),
+  m_length(0),
+  m_offset(0),
+  m_recordValid(false),
+  m_fast(false),
+  m_lastWasTx(false),
+  m_offsetUs(0),
+  m_startBaudrate(0),
+  m_matchedCount(0),
+  m_mismatchedCount(0),
+  m_extraTxCount(0),
+  m_skippedRxCount(0),
+  m_deliveredRxCount(0),
+  m_configCount(0)
+{
+}
+
+// ----------------------------------------------------------------------------
+/// \brief     Load a capture
+/// \detail    startUs: replay time of the capture start. fast: replies as soon as
+///            their request is sent, for benchmarks
+/// \warning   data must stay valid during the replay
+/// \return    RC_OK, RC_INV_PARAM if data is no capture
+/// \todo
+///
+uint8_t CaptureReplay::initialize(const uint8_t data[], const uint32_t length, const uint32_t startUs, const bool fast)
+{
+  uint8_t errorCode = BusCapture::checkHeader(data, length, m_startBaudrate);
+  if (errorCode != RC_OK) return errorCode;
+
+  m_data             = data;
+  m_length           = length;
+  m_offset           = BusCapture::HEADER_LENGTH;
+  m_record.timeUs    = 0;
+  m_fast             = fast;
+  m_lastWasTx        = false;
+  m_offsetUs         = startUs;
+  m_matchedCount     = 0;
+  m_mismatchedCount  = 0;
+  m_extraTxCount     = 0;
+  m_skippedRxCount   = 0;
+  m_deliveredRxCount = 0;
+  m_configCount      = 0;
+  next();
+  return RC_OK;
+}
+
+// ----------------------------------------------------------------------------
+/// \brief     One byte from the master
+/// \detail    Compared with the next TX record. Captured replies not yet handed out
+///            are dropped: the master did not wait for them.
+/// \warning   timeUs: time of the write() call, like the capture
+/// \return
+/// \todo
+///
+void CaptureReplay::receive(const uint8_t data, const uint32_t timeUs)
+{
+  while (m_recordValid && m_record.type == BUS_CAPTURE_RX)
+  {
+    m_skippedRxCount++;
+    m_lastWasTx = false;
+    next();
+  }
+  if (!m_recordValid)
+  {
+    m_extraTxCount++;
+    return;
+  }
+
+  if (!m_lastWasTx) m_offsetUs = timeUs - m_record.timeUs; // First byte of a request
+  if (data == m_record.data) m_matchedCount++;
+  else m_mismatchedCount++;
+  m_lastWasTx = true;
+  next();
+}
+
+// ----------------------------------------------------------------------------
+/// \brief     Next reply byte, if due
+/// \detail    A reply byte is due at its captured time after the request
+/// \warning
+/// \return    true if data is valid
+/// \todo
+///
+bool CaptureReplay::transmit(const uint32_t nowUs, uint8_t& data)
+{
+  if (!m_recordValid || m_record.type != BUS_CAPTURE_RX) return false;
+  if (!m_fast && (int32_t)(nowUs - (m_record.timeUs + m_offsetUs)) < 0) return false;
+
+  data = m_record.data;
+  m_deliveredRxCount++;
+  m_lastWasTx = false;
+  next();
+  return true;
+}
+
+bool CaptureReplay::isFinished()
+{
+  return !m_recordValid;
+}
+
+unsigned long CaptureReplay::getStartBaudrate()
+{
+  return m_startBaudrate;
+}
+
+uint32_t CaptureReplay::getMatchedCount()
+{
+  return m_matchedCount;
+}
+
+uint32_t CaptureReplay::getMismatchedCount()
+{
+  return m_mismatchedCount;
+}
+
+uint32_t CaptureReplay::getExtraTxCount()
+{
+  return m_extraTxCount;
+}
+
+uint32_t CaptureReplay::getSkippedRxCount()
+{
+  return m_skippedRxCount;
+}
+
+uint32_t CaptureReplay::getDeliveredRxCount()
+{
+  return m_deliveredRxCount;
+}
+
+uint32_t CaptureReplay::getConfigCount()
+{
+  return m_configCount;
+}
+
+/// <summary>
+/// Decodes the next RX or TX record, begin() records are only counted.
+/// A truncated or invalid record ends the replay.
+/// </summary>
+void CaptureReplay::next()
+{
+  m_recordValid = false;
+  while (m_offset < m_length)
+  {
+    if (BusCapture::decode(m_data, m_length, m_offset, m_record) != RC_OK) return;
+    if (m_record.type != BUS_CAPTURE_CONFIG)
+    {
+      m_recordValid = true;
+      return;
+    }
+    m_configCount++;
+  }
+}
@@ -0,0 +1,78 @@
+// ****************************************************************************
+/// \file      CaptureReplay.hpp
+///
+/// \brief     Replays a BusCapture log in place of the encoder
+///
+/// \details   Takes the place of the HA40Simulator behind Serial1. The bytes the
+///            master writes are compared with the TX records of the capture, the
+///            RX records are handed out as replies: at their original time after
+///            the request that preceded them, or as soon as that request is sent
+///            (fast mode). So a field capture runs through the current Encoder
+///            code offline, with the timing of the field.
+///
+/// \author    Christoph Capiaghi
+///
+/// \version   0.1
+///
+/// \date      20221017
+///
+/// \copyright Licensed under the Apache License, Version 2.0 (the "License");
+/// you may not use this file except in compliance with the License.
+/// You may obtain a copy of the License at
+/// http://www.apache.org/licenses/LICENSE-2.0
+///
+/// \pre
+///
+/// \bug
+///
+/// \warning   The replay follows the capture, not the requests: if the current
+///            code sends other requests than the captured one, the replies do not
+///            fit any more. The mismatch counters tell.
+///
+/// \todo
+///
+
+// Prevent recursive inclusion
+#pragma once
+
+#include <stdint.h>
+#include "../BusCapture.hpp"
+
+class CaptureReplay
+{
+public:
+    CaptureReplay();
+    uint8_t initialize(const uint8_t data[], const uint32_t length, const uint32_t startUs, const bool fast);
+
+    void receive(const uint8_t data, const uint32_t timeUs);
+    bool transmit(const uint32_t nowUs, uint8_t& data);
+    bool isFinished();
+
+    unsigned long getStartBaudrate();
+    uint32_t getMatchedCount();
+    uint32_t getMismatchedCount();
+    uint32_t getExtraTxCount();
+    uint32_t getSkippedRxCount();
+    uint32_t getDeliveredRxCount();
+    uint32_t getConfigCount();
+
+private:
+    const uint8_t* m_data;
+    uint32_t m_length;
+    uint32_t m_offset;               /// Behind m_record
+    bus_capture_record_t m_record;   /// Next record to replay
+    bool m_recordValid;              /// false: end of the capture
+    bool m_fast;                     /// Replies without the captured delay
+    bool m_lastWasTx;                /// Last replayed record was a TX byte
+    uint32_t m_offsetUs;             /// Replay time minus capture time, set by the first byte of each request
+    unsigned long m_startBaudrate;
+
+    uint32_t m_matchedCount;         /// TX bytes equal to the capture
+    uint32_t m_mismatchedCount;      /// TX bytes different from the capture
+    uint32_t m_extraTxCount;         /// TX bytes after the end of the capture
+    uint32_t m_skippedRxCount;       /// Captured replies dropped, the master sent the next request first
+    uint32_t m_deliveredRxCount;
+    uint32_t m_configCount;          /// begin() records passed
+
+    void next();
+};
@@ -0,0 +1,482 @@
+// ****************************************************************************
+/// \file      HA40Simulator.cpp
+///
+/// \brief     Host model of the HA40+ encoder
+///
+/// \details   Request bytes are collected like on the encoder: a frame starts with
+///            a master address (high nibble F), a gap of more than
+///            INTER_CHAR_GAP_CHARS character times drops a partial frame. The angle
+///            is latched at the end of the request, the reply is scheduled byte by
+///            byte at the current baud rate after the reply latency. Request bytes
+///            which collide with a reply on the half duplex line are lost.
+///
+/// \author    Christoph Capiaghi
+///
+/// \version   0.1
+///
+/// \date      20221017
+///
+/// \copyright Licensed under the Apache License, Version 2.0 (the "License");
+/// you may not use this file except in compliance with the License.
+/// You may obtain a copy of the License at
+/// http://www.apache.org/licenses/LICENSE-2.0
+///
+/// \pre
+///
+/// \bug
+///
+/// \warning   Angles of a B command with N angles are N independent noisy readings
+///            of the same latch time.
+///
+/// \todo
+///
+
+#include <stdint.h>
+#include <math.h>
+#include "HA40Simulator.hpp"
+#include "../RomerCodec.hpp"
+extern "C" {
+#include "../crc8.h"   // Reference implementation, cross-checks Crc8.hpp of the firmware
+}
+
+HA40Simulator::HA40Simulator() :
+  m_baudrate(0),
+  m_pendingBaudrate(0),
+  m_eightBitMode(false),
+  m_unlockCount(0),
+  m_triggerLevel(false),
+  m_latchedRawAngle(0),
+  m_requestLength(0),
+  m_lastRxTimeUs(0),
+  m_txHead(0),
+  m_txCount(0),
+  m_lineFreeTimeUs(0),
+  m_random(1),
+  m_requestCount(0),
+  m_replyCount(0),
+  m_corruptedReplyCount(0),
+  m_droppedRequestCount(0),
+  m_ignoredByteCount(0),
+  m_latchCount(0)
+{
+  initialize(getDefaultConfig());
+}
+
+// ----------------------------------------------------------------------------
+/// \brief     Default behaviour
+/// \detail    Cold start at 230400 bit/s, slave 1, knob at rest, no noise, no errors
+/// \warning
+/// \return    Configuration
+/// \todo
+///
+ha40sim_config_t HA40Simulator::getDefaultConfig()
+{
+  ha40sim_config_t config;
+  config.slaveAddress        = 1;
+  config.baudrate            = 230400;
+  config.powerUpUs           = 200000;
+  config.startInEightBitMode = false;
+  config.replyLatencyUs      = 150;
+  config.latencyJitterUs     = 0;
+  config.startAngleDeg       = 0.0;
+  config.velocityDegPerS     = 0.0;
+  config.wobbleAmplitudeDeg  = 0.0;
+  config.wobbleFrequencyHz   = 0.0;
+  config.noiseCounts         = 0.0;
+  config.byteErrorRate       = 0.0;
+  config.dropRate            = 0.0;
+  config.outageStartUs       = 0;
+  config.outageLengthUs      = 0;
+  config.seed                = 1;
+  return config;
+}
+
+// ----------------------------------------------------------------------------
+/// \brief     Power up with a new configuration
+/// \detail    Registers 0x0000 ... 0x000F hold identity values, the baud rate
+///            register the link rate
+/// \warning
+/// \return
+/// \todo
+///
+void HA40Simulator::initialize(const ha40sim_config_t& config)
+{
+  m_config          = config;
+  m_baudrate        = config.baudrate;
+  m_pendingBaudrate = 0;
+  m_eightBitMode    = config.startInEightBitMode;
+  m_unlockCount     = 0;
+  m_triggerLevel    = false;
+  m_latchedRawAngle = 0;
+  m_requestLength   = 0;
+  m_txHead          = 0;
+  m_txCount         = 0;
+  m_lineFreeTimeUs  = 0;
+  m_random          = (config.seed != 0) ? config.seed : 1;
+
+  for (uint16_t i = 0; i < NUMBER_OF_REGISTERS; i++)
+  {
+    m_registers[i] = 0x48410000UL | i; // "HA" + register number
+  }
+  m_registers[BAUDRATE_REGISTER]     = m_baudrate;
+  m_registers[TRIGGER_MODE_REGISTER] = 0;
+
+  m_requestCount        = 0;
+  m_replyCount          = 0;
+  m_corruptedReplyCount = 0;
+  m_droppedRequestCount = 0;
+  m_ignoredByteCount    = 0;
+  m_latchCount          = 0;
+}
+
+// ----------------------------------------------------------------------------
+/// \brief     One byte arrives from the master
+/// \detail    ninthBit: the bit after the 8 data bits as the encoder samples it,
+///            i.e. the parity bit if the master sends with parity
+/// \warning   timeUs: end of the byte on the line
+/// \return
+/// \todo
+///
+void HA40Simulator::receive(const uint8_t data, const bool ninthBit, const unsigned long baudrate, const uint32_t timeUs)
+{
+  // Half duplex: a byte sent while the reply is on the line is lost in the collision
+  bool collision = (m_txCount > 0) && (int32_t)(timeUs - (m_txTimeUs[m_txHead] - getCharTimeUs())) > 0;
+  if (m_config.outageLengthUs > 0 && (timeUs - m_config.outageStartUs) < m_config.outageLengthUs)
+  {
+    // Unpowered: comes back like after power-up
+    m_eightBitMode  = false;
+    m_unlockCount   = 0;
+    m_baudrate      = m_config.baudrate;
+    m_registers[TRIGGER_MODE_REGISTER] = 0;
+    m_ignoredByteCount++;
+    m_requestLength = 0;
+    return;
+  }
+  if ((int32_t)(timeUs - m_config.powerUpUs) < 0 || baudrate != m_baudrate || collision)
+  {
+    m_ignoredByteCount++;
+    m_requestLength = 0;
+    return;
+  }
+
+  if (!m_eightBitMode)
+  {
+    // 9 bit mode: only the parity trick of Encoder::setEightBitMode() is understood
+    static const uint8_t UNLOCK_SEQUENCE[] = { 0xFF, 0xFF, 0xAA, 0xAA };
+    if (ninthBit && data == UNLOCK_SEQUENCE[m_unlockCount])
+    {
+      m_unlockCount++;
+      if (m_unlockCount == sizeof(UNLOCK_SEQUENCE))
+      {
+        m_eightBitMode = true;
+        m_unlockCount  = 0;
+      }
+    }
+    else
+    {
+      m_unlockCount = (ninthBit && data == UNLOCK_SEQUENCE[0]) ? 1 : 0;
+      m_ignoredByteCount++;
+    }
+    return;
+  }
+
+  if (ninthBit)
+  {
+    // Parity bit where the stop bit is expected: framing error
+    m_ignoredByteCount++;
+    m_requestLength = 0;
+    return;
+  }
+
+  if (m_requestLength > 0 && (timeUs - m_lastRxTimeUs) > INTER_CHAR_GAP_CHARS * getCharTimeUs())
+  {
+    m_ignoredByteCount += m_requestLength;
+    m_requestLength = 0;
+  }
+  m_lastRxTimeUs = timeUs;
+
+  if (m_requestLength == 0 && (data & ROMER_MASTER_NIBBLE_TX) != ROMER_MASTER_NIBBLE_TX)
+  {
+    m_ignoredByteCount++;
+    return;
+  }
+
+  m_request[m_requestLength++] = data;
+  if (m_requestLength > RomerBRequest::LENGTH_FIELD)
+  {
+    uint8_t length = m_request[RomerBRequest::LENGTH_FIELD];
+    if (length < 2 || length + RomerBRequest::HEADER_LENGTH > MAX_FRAME_LENGTH)
+    {
+      m_ignoredByteCount += m_requestLength;
+      m_requestLength = 0;
+      return;
+    }
+    if (m_requestLength == length + RomerBRequest::HEADER_LENGTH)
+    {
+      handleRequest(timeUs);
+      m_requestLength = 0;
+    }
+  }
+}
+
+// ----------------------------------------------------------------------------
+/// \brief     Next reply byte, if it is complete on the line at nowUs
+/// \detail    The baud rate changes after the last byte of a W reply
+/// \warning
+/// \return    true if data is valid
+/// \todo
+///
+bool HA40Simulator::transmit(const uint32_t nowUs, uint8_t& data)
+{
+  if (m_txCount == 0 || (int32_t)(nowUs - m_txTimeUs[m_txHead]) < 0) return false;
+
+  data = m_txData[m_txHead];
+  m_txHead = (m_txHead + 1) % MAX_PENDING_BYTES;
+  m_txCount--;
+
+  if (m_txCount == 0 && m_pendingBaudrate != 0)
+  {
+    m_baudrate        = m_pendingBaudrate;
+    m_pendingBaudrate = 0;
+    m_requestLength   = 0;
+  }
+  return true;
+}
+
+uint32_t HA40Simulator::getNextTransmitTimeUs()
+{
+  return m_txTimeUs[m_txHead];
+}
+
+bool HA40Simulator::isTransmitPending()
+{
+  return m_txCount > 0;
+}
+
+// ----------------------------------------------------------------------------
+/// \brief     Level of the trigger input
+/// \detail    A rising edge latches the angle. In trigger mode (register
+///            TRIGGER_MODE_REGISTER != 0) the B command replies the latched angle.
+/// \warning   timeUs: time of the level change
+/// \return
+/// \todo
+///
+void HA40Simulator::setTriggerInput(const bool level, const uint32_t timeUs)
+{
+  if (level && !m_triggerLevel)
+  {
+    m_latchedRawAngle = getTrueRawAngle(timeUs);
+    m_latchCount++;
+  }
+  m_triggerLevel = level;
+}
+
+// ----------------------------------------------------------------------------
+/// \brief     Knob position without noise
+/// \detail    Reference for latency and timestamp measurements
+/// \warning
+/// \return    Raw angle 0 ... 2^32-1
+/// \todo
+///
+uint32_t HA40Simulator::getTrueRawAngle(const uint32_t timeUs)
+{
+  double t = timeUs * 1e-6;
+  double angleDeg = m_config.startAngleDeg + m_config.velocityDegPerS * t
+                  + m_config.wobbleAmplitudeDeg * sin(2.0 * M_PI * m_config.wobbleFrequencyHz * t);
+  angleDeg = fmod(angleDeg, 360.0);
+  if (angleDeg < 0.0) angleDeg += 360.0;
+  return (uint32_t)(uint64_t)(angleDeg / 360.0 * 4294967296.0);
+}
+
+unsigned long HA40Simulator::getBaudrate()
+{
+  return m_baudrate;
+}
+
+bool HA40Simulator::isEightBitMode()
+{
+  return m_eightBitMode;
+}
+
+bool HA40Simulator::isTriggerMode()
+{
+  return m_registers[TRIGGER_MODE_REGISTER] != 0;
+}
+
+uint32_t HA40Simulator::getRequestCount()
+{
+  return m_requestCount;
+}
+
+uint32_t HA40Simulator::getReplyCount()
+{
+  return m_replyCount;
+}
+
+uint32_t HA40Simulator::getCorruptedReplyCount()
+{
+  return m_corruptedReplyCount;
+}
+
+uint32_t HA40Simulator::getDroppedRequestCount()
+{
+  return m_droppedRequestCount;
+}
+
+uint32_t HA40Simulator::getIgnoredByteCount()
+{
+  return m_ignoredByteCount;
+}
+
+uint32_t HA40Simulator::getLatchCount()
+{
+  return m_latchCount;
+}
+
+/// <summary>
+/// Answers a complete request: B, G and W command. Invalid requests get no reply.
+/// </summary>
+/// <param name="timeUs">End of the request, the angle is latched here (not in trigger mode)</param>
+void HA40Simulator::handleRequest(const uint32_t timeUs)
+{
+  uint8_t length = m_requestLength;
+  if (CSV_CalcCRC8(m_request, length - 1) != m_request[length - 1])
+  {
+    m_ignoredByteCount += length;
+    return;
+  }
+  uint8_t slaveAddress = m_request[RomerBRequest::ADDRESS_FIELD] & 0x0F;
+  if (slaveAddress != 0 && slaveAddress != m_config.slaveAddress) return;
+
+  m_requestCount++;
+  if (nextUniform() < m_config.dropRate)
+  {
+    m_droppedRequestCount++;
+    return;
+  }
+
+  uint8_t replyAddress = (uint8_t)((m_config.slaveAddress << 4) | 0x0F);
+  uint8_t frame[MAX_FRAME_LENGTH];
+  switch (m_request[RomerBRequest::COMMAND_FIELD])
+  {
+    case RomerBRequest::COMMAND:
+    {
+      uint8_t n = m_request[RomerBRequest::NUMBER_FIELD];
+      if (length != RomerBRequest::frameLength(0) || n == 0 || n > MAX_ANGLES) return;
+
+      uint32_t rawAngle = (m_registers[TRIGGER_MODE_REGISTER] != 0) ? m_latchedRawAngle : getTrueRawAngle(timeUs);
+      RomerBReply::writeHeader(frame, 0, n);
+      frame[RomerBReply::ADDRESS_FIELD] = replyAddress;
+      for (uint8_t i = 0; i < n; i++)
+      {
+        int32_t noise = (int32_t)lround(nextGaussian() * m_config.noiseCounts);
+        frame[RomerBReply::blockField(i) + RomerBReply::ANGLE_INFO_OFFSET] = 0x00;
+        RomerBReply::writeUint32(frame, RomerBReply::blockField(i) + RomerBReply::ANGLE_OFFSET, rawAngle + (uint32_t)noise);
+      }
+      reply(frame, RomerBReply::seal(frame, n), timeUs);
+      break;
+    }
+    case RomerGRequest::COMMAND:
+    {
+      uint16_t registerAddress = m_request[RomerGRequest::REGISTER_FIELD] | (m_request[RomerGRequest::REGISTER_FIELD + 1] << 8);
+      uint8_t n = m_request[RomerGRequest::NUMBER_FIELD];
+      if (length != RomerGRequest::frameLength(0) || n == 0 || n > MAX_REGISTERS) return;
+      if (registerAddress + n > NUMBER_OF_REGISTERS) return;
+
+      RomerGReply::writeHeader(frame, 0, n);
+      frame[RomerGReply::ADDRESS_FIELD] = replyAddress;
+      for (uint8_t i = 0; i < n; i++)
+      {
+        RomerGReply::writeUint32(frame, RomerGReply::blockField(i), m_registers[registerAddress + i]);
+      }
+      reply(frame, RomerGReply::seal(frame, n), timeUs);
+      break;
+    }
+    case RomerWRequest::COMMAND:
+    {
+      uint16_t registerAddress = m_request[RomerWRequest::REGISTER_FIELD] | (m_request[RomerWRequest::REGISTER_FIELD + 1] << 8);
+      uint8_t n = m_request[RomerWRequest::NUMBER_FIELD];
+      if (n == 0 || n > MAX_REGISTERS || length != RomerWRequest::frameLength(n)) return;
+      if (registerAddress + n > NUMBER_OF_REGISTERS) return;
+
+      for (uint8_t i = 0; i < n; i++)
+      {
+        uint32_t value = RomerWRequest::readUint32(m_request, RomerWRequest::blockField(i));
+        if (registerAddress + i == BAUDRATE_REGISTER)
+        {
+          if (value == 0) return; // Not accepted, no reply
+          m_pendingBaudrate = value;
+        }
+        m_registers[registerAddress + i] = value;
+      }
+      RomerWReply::writeHeader(frame, 0, 0);
+      frame[RomerWReply::ADDRESS_FIELD] = replyAddress;
+      reply(frame, RomerWReply::seal(frame, 0), timeUs);
+      break;
+    }
+    default:
+      break;
+  }
+}
+
+/// <summary>
+/// Schedules the reply bytes after the latency, at the current baud rate
+/// </summary>
+void HA40Simulator::reply(const uint8_t frame[], const uint8_t length, const uint32_t timeUs)
+{
+  uint32_t jitterUs = (m_config.latencyJitterUs > 0) ? nextRandom() % (m_config.latencyJitterUs + 1) : 0;
+  uint32_t startUs  = timeUs + m_config.replyLatencyUs + jitterUs;
+  if (m_txCount > 0 && (int32_t)(m_lineFreeTimeUs - startUs) > 0) startUs = m_lineFreeTimeUs;
+
+  bool corrupted = false;
+  for (uint8_t i = 0; i < length && m_txCount < MAX_PENDING_BYTES; i++)
+  {
+    uint8_t data = frame[i];
+    if (nextUniform() < m_config.byteErrorRate)
+    {
+      data ^= (uint8_t)(1 << (nextRandom() & 0x07));
+      corrupted = true;
+    }
+    uint16_t tail = (m_txHead + m_txCount) % MAX_PENDING_BYTES;
+    m_txData[tail]   = data;
+    m_txTimeUs[tail] = startUs + (i + 1) * getCharTimeUs();
+    m_txCount++;
+  }
+  m_lineFreeTimeUs = startUs + length * getCharTimeUs();
+  m_replyCount++;
+  if (corrupted) m_corruptedReplyCount++;
+}
+
+/// <summary>
+/// Duration of one 8N1 character at the current baud rate, rounded up
+/// </summary>
+uint32_t HA40Simulator::getCharTimeUs()
+{
+  return (10UL * 1000000UL + m_baudrate - 1) / m_baudrate;
+}
+
+/// <summary>
+/// xorshift32, reproducible for a given seed
+/// </summary>
+uint32_t HA40Simulator::nextRandom()
+{
+  m_random ^= m_random << 13;
+  m_random ^= m_random >> 17;
+  m_random ^= m_random << 5;
+  return m_random;
+}
+
+double HA40Simulator::nextUniform()
+{
+  return nextRandom() / 4294967296.0;
+}
+
+/// <summary>
+/// Standard normal distribution, Box-Muller
+/// </summary>
+double HA40Simulator::nextGaussian()
+{
+  double u1 = (nextRandom() + 1.0) / 4294967297.0;
+  double u2 = nextUniform();
+  return sqrt(-2.0 * log(u1)) * cos(2.0 * M_PI * u2);
+}
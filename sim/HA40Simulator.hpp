@@ -0,0 +1,131 @@
+// ****************************************************************************
+/// \file      HA40Simulator.hpp
+///
+/// \brief     Host model of the HA40+ encoder
+///
+/// \details   Speaks the Romer protocol like the encoder on the RS-485 bus:
+///            9 bit mode after power-up until the parity trick is received,
+///            B command (angles), G command (read registers), W command (write
+///            registers, baud rate, trigger mode). The knob angle follows a motion model with
+///            noise; reply latency, bit errors and lost replies are configurable.
+///            Independent of the transport: the caller feeds request bytes with
+///            their time and fetches reply bytes when they are due.
+///
+/// \author    Christoph Capiaghi
+///
+/// \version   0.1
+///
+/// \date      20221017
+///
+/// \copyright Licensed under the Apache License, Version 2.0 (the "License");
+/// you may not use this file except in compliance with the License.
+/// You may obtain a copy of the License at
+/// http://www.apache.org/licenses/LICENSE-2.0
+///
+/// \pre
+///
+/// \bug
+///
+/// \warning   Model, not a reference: the 9 bit mode only recognizes the parity
+///            trick of Encoder::setEightBitMode(), other 9 bit traffic is ignored.
+///
+/// \todo
+///
+
+// Prevent recursive inclusion
+#pragma once
+
+#include <stdint.h>
+
+/// \brief Behaviour of the simulated encoder
+typedef struct ha40sim_config_s
+{
+  uint8_t  slaveAddress;          /// Own address 1 ... 14, broadcast requests are answered too
+  unsigned long baudrate;         /// Link rate after power-up
+  uint32_t powerUpUs;             /// Requests before this time are ignored
+  bool     startInEightBitMode;   /// true: warm start, no parity trick needed
+  uint32_t replyLatencyUs;        /// End of request to start of the first reply byte
+  uint32_t latencyJitterUs;       /// Uniform 0 ... jitter on top of the latency
+  double   startAngleDeg;         /// Knob angle at time 0
+  double   velocityDegPerS;       /// Constant knob rotation
+  double   wobbleAmplitudeDeg;    /// Sinusoidal knob motion on top of the rotation
+  double   wobbleFrequencyHz;
+  double   noiseCounts;           /// Standard deviation of the angle noise, raw counts
+  double   byteErrorRate;         /// Probability of one flipped bit per reply byte
+  double   dropRate;              /// Probability that a valid request gets no reply
+  uint32_t outageStartUs;         /// Power loss at this time ...
+  uint32_t outageLengthUs;        /// ... for this long, back in 9 bit mode afterwards. 0: none
+  uint32_t seed;                  /// Random generator seed, same seed: same run
+} ha40sim_config_t;
+
+class HA40Simulator
+{
+public:
+    static const uint16_t NUMBER_OF_REGISTERS = 0x20;
+    static const uint16_t BAUDRATE_REGISTER   = 0x0010;   /// Same as ENCODER_BAUDRATE_REGISTER
+    static const uint16_t TRIGGER_MODE_REGISTER = 0x0011; /// Same as ENCODER_TRIGGER_MODE_REGISTER
+
+    HA40Simulator();
+    static ha40sim_config_t getDefaultConfig();
+    void initialize(const ha40sim_config_t& config);
+
+    void receive(const uint8_t data, const bool ninthBit, const unsigned long baudrate, const uint32_t timeUs);
+    bool transmit(const uint32_t nowUs, uint8_t& data);
+    uint32_t getNextTransmitTimeUs();
+    bool isTransmitPending();
+    void setTriggerInput(const bool level, const uint32_t timeUs);
+
+    uint32_t getTrueRawAngle(const uint32_t timeUs);
+    unsigned long getBaudrate();
+    bool isEightBitMode();
+    bool isTriggerMode();
+
+    uint32_t getRequestCount();
+    uint32_t getReplyCount();
+    uint32_t getCorruptedReplyCount();
+    uint32_t getDroppedRequestCount();
+    uint32_t getIgnoredByteCount();
+    uint32_t getLatchCount();
+
+private:
+    static const uint8_t  MAX_FRAME_LENGTH    = 48;
+    static const uint16_t MAX_PENDING_BYTES   = 256;
+    static const uint8_t  MAX_ANGLES          = 8;
+    static const uint8_t  MAX_REGISTERS       = 8;
+    static const uint8_t  INTER_CHAR_GAP_CHARS = 4;  /// A longer gap starts a new request
+
+    ha40sim_config_t m_config;
+    unsigned long m_baudrate;         /// Current link rate
+    unsigned long m_pendingBaudrate;  /// New rate after the W reply is out, 0: none
+    bool m_eightBitMode;              /// false: 9 bit mode, waiting for the parity trick
+    uint8_t m_unlockCount;            /// Bytes of the parity trick received so far
+    bool m_triggerLevel;              /// Level of the trigger input
+    uint32_t m_latchedRawAngle;       /// Angle of the last rising edge, replied in trigger mode
+
+    uint8_t  m_request[MAX_FRAME_LENGTH];  /// Request being received
+    uint8_t  m_requestLength;
+    uint32_t m_lastRxTimeUs;
+
+    uint8_t  m_txData[MAX_PENDING_BYTES];  /// Reply bytes, ring buffer
+    uint32_t m_txTimeUs[MAX_PENDING_BYTES]; /// Time each reply byte is complete
+    uint16_t m_txHead;
+    uint16_t m_txCount;
+    uint32_t m_lineFreeTimeUs;             /// End of the last scheduled reply byte
+
+    uint32_t m_registers[NUMBER_OF_REGISTERS];
+    uint32_t m_random;                     /// xorshift32 state
+
+    uint32_t m_requestCount;
+    uint32_t m_replyCount;
+    uint32_t m_corruptedReplyCount;
+    uint32_t m_droppedRequestCount;
+    uint32_t m_ignoredByteCount;
+    uint32_t m_latchCount;
+
+    void handleRequest(const uint32_t timeUs);
+    void reply(const uint8_t frame[], const uint8_t length, const uint32_t timeUs);
+    uint32_t getCharTimeUs();
+    uint32_t nextRandom();
+    double nextUniform();
+    double nextGaussian();
+};
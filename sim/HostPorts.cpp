@@ -0,0 +1,283 @@
+// ****************************************************************************
+/// \file      HostPorts.cpp
+///
+/// \brief     Port policies of the SerialHandler for Linux
+///
+/// \details   See HostPorts.hpp
+///
+/// \author    Christoph Capiaghi
+///
+/// \version   0.1
+///
+/// \date      20221017
+///
+/// \copyright Licensed under the Apache License, Version 2.0 (the "License");
+/// you may not use this file except in compliance with the License.
+/// You may obtain a copy of the License at
+/// http://www.apache.org/licenses/LICENSE-2.0
+///
+/// \pre
+///
+/// \bug
+///
+/// \warning   Linux only
+///
+/// \todo
+///
+
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <termios.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include "arduino.h"
+#include "HostPorts.hpp"
+
+// ----------------------------------------------------------------------------
+// TermiosPort
+
+int      TermiosPort::s_fd = -1;
+uint8_t  TermiosPort::s_chunk[TermiosPort::READ_CHUNK];
+uint16_t TermiosPort::s_chunkOffset = 0;
+uint16_t TermiosPort::s_chunkLength = 0;
+
+/// <summary>
+/// termios speed of a baud rate, B0 if there is none
+/// </summary>
+static speed_t toSpeed(const unsigned long baudrate)
+{
+  switch (baudrate)
+  {
+    case 9600:    return B9600;
+    case 19200:   return B19200;
+    case 38400:   return B38400;
+    case 57600:   return B57600;
+    case 115200:  return B115200;
+    case 230400:  return B230400;
+    case 460800:  return B460800;
+    case 921600:  return B921600;
+    default:      return B0;
+  }
+}
+
+// ----------------------------------------------------------------------------
+/// \brief     Open the device of the encoder link
+/// \detail    device: e.g. /dev/ttyUSB0 or the link of ha40sim_pty
+/// \warning   Call before SerialHandler::initialize()
+/// \return    false if the device cannot be opened
+/// \todo
+///
+bool TermiosPort::open(const char* device)
+{
+  close();
+  s_fd = ::open(device, O_RDWR | O_NOCTTY | O_NONBLOCK);
+  if (s_fd < 0) return false;
+  tcflush(s_fd, TCIOFLUSH);
+  return true;
+}
+
+void TermiosPort::close()
+{
+  if (s_fd >= 0) ::close(s_fd);
+  s_fd = -1;
+  s_chunkOffset = 0;
+  s_chunkLength = 0;
+}
+
+// ----------------------------------------------------------------------------
+/// \brief     Raw mode, 8 data bits, parity of config
+/// \detail    Bytes already written go out with the old settings first, like
+///            Serial1.flush() before Serial1.begin() on the target
+/// \warning   A baud rate without termios speed keeps the old one
+/// \return
+/// \todo
+///
+void TermiosPort::begin(const unsigned long baudrate, const uint16_t config)
+{
+  if (s_fd < 0) return;
+  struct termios settings;
+  if (tcgetattr(s_fd, &settings) != 0) return;
+  cfmakeraw(&settings);
+  settings.c_cflag |= CLOCAL | CREAD;
+  settings.c_cflag &= ~(PARENB | PARODD | CSTOPB);
+  if (config == SERIAL_8E1) settings.c_cflag |= PARENB;
+  if (config == SERIAL_8O1) settings.c_cflag |= PARENB | PARODD;
+  settings.c_cc[VMIN]  = 0;
+  settings.c_cc[VTIME] = 0;
+  speed_t speed = toSpeed(baudrate);
+  if (speed != B0)
+  {
+    cfsetispeed(&settings, speed);
+    cfsetospeed(&settings, speed);
+  }
+  else
+  {
+    fprintf(stderr, "TermiosPort: no termios speed for %lu bit/s\n", baudrate);
+  }
+  tcsetattr(s_fd, TCSADRAIN, &settings);
+}
+
+void TermiosPort::end()
+{
+}
+
+int TermiosPort::available()
+{
+  int pending = 0;
+  if (s_fd >= 0 && ioctl(s_fd, FIONREAD, &pending) != 0) pending = 0;
+  return (s_chunkLength - s_chunkOffset) + pending;
+}
+
+/// <summary>
+/// Oldest byte, read from the device in chunks
+/// </summary>
+/// <returns>-1 if none</returns>
+int TermiosPort::read()
+{
+  if (s_chunkOffset == s_chunkLength)
+  {
+    if (s_fd < 0) return -1;
+    ssize_t length = ::read(s_fd, s_chunk, sizeof(s_chunk));
+    if (length <= 0) return -1;
+    s_chunkOffset = 0;
+    s_chunkLength = (uint16_t)length;
+  }
+  return s_chunk[s_chunkOffset++];
+}
+
+/// <summary>
+/// Queues the bytes in the tty layer, waits only while it is full
+/// </summary>
+size_t TermiosPort::write(const uint8_t data[], const size_t length)
+{
+  size_t written = 0;
+  while (s_fd >= 0 && written < length)
+  {
+    ssize_t result = ::write(s_fd, data + written, length - written);
+    if (result > 0) written += result;
+    else usleep(100);
+  }
+  return written;
+}
+
+void TermiosPort::flush()
+{
+  if (s_fd >= 0) tcdrain(s_fd);
+}
+
+// ----------------------------------------------------------------------------
+// MemoryPort
+
+uint8_t  MemoryPort::s_rxBuffer[MemoryPort::RX_BUFFER_SIZE];
+uint16_t MemoryPort::s_rxHead = 0;
+uint16_t MemoryPort::s_rxCount = 0;
+uint8_t  MemoryPort::s_txBuffer[MemoryPort::TX_BUFFER_SIZE];
+uint16_t MemoryPort::s_txCount = 0;
+unsigned long MemoryPort::s_baudrate = 0;
+uint16_t MemoryPort::s_config = 0;
+uint32_t MemoryPort::s_lostRxCount = 0;
+
+void MemoryPort::begin(const unsigned long baudrate, const uint16_t config)
+{
+  s_baudrate = baudrate;
+  s_config   = config;
+}
+
+void MemoryPort::end()
+{
+}
+
+int MemoryPort::available()
+{
+  return s_rxCount;
+}
+
+int MemoryPort::read()
+{
+  if (s_rxCount == 0) return -1;
+  uint8_t data = s_rxBuffer[s_rxHead];
+  s_rxHead = (s_rxHead + 1) % RX_BUFFER_SIZE;
+  s_rxCount--;
+  return data;
+}
+
+/// <summary>
+/// Appends the bytes to the TX queue, bytes beyond TX_BUFFER_SIZE are not written
+/// </summary>
+size_t MemoryPort::write(const uint8_t data[], const size_t length)
+{
+  size_t written = 0;
+  while (written < length && s_txCount < TX_BUFFER_SIZE)
+  {
+    s_txBuffer[s_txCount++] = data[written++];
+  }
+  return written;
+}
+
+void MemoryPort::flush()
+{
+}
+
+// ----------------------------------------------------------------------------
+/// \brief     Bytes for read(), as if received
+/// \detail    Full like the ring of the core at RX_BUFFER_SIZE - 1, the rest is lost
+/// \warning
+/// \return    Bytes taken
+/// \todo
+///
+size_t MemoryPort::inject(const uint8_t data[], const size_t length)
+{
+  size_t taken = 0;
+  for (size_t i = 0; i < length; i++)
+  {
+    if (s_rxCount == RX_BUFFER_SIZE - 1)
+    {
+      s_lostRxCount++;
+      continue;
+    }
+    s_rxBuffer[(s_rxHead + s_rxCount) % RX_BUFFER_SIZE] = data[i];
+    s_rxCount++;
+    taken++;
+  }
+  return taken;
+}
+
+// ----------------------------------------------------------------------------
+/// \brief     Bytes written since the last call
+/// \detail    Oldest first, at most maxLength, the rest stays queued
+/// \warning
+/// \return    Number of bytes copied to data
+/// \todo
+///
+size_t MemoryPort::takeTx(uint8_t data[], const size_t maxLength)
+{
+  size_t length = (s_txCount < maxLength) ? s_txCount : maxLength;
+  memcpy(data, s_txBuffer, length);
+  memmove(s_txBuffer, s_txBuffer + length, s_txCount - length);
+  s_txCount -= length;
+  return length;
+}
+
+void MemoryPort::clear()
+{
+  s_rxHead      = 0;
+  s_rxCount     = 0;
+  s_txCount     = 0;
+  s_lostRxCount = 0;
+}
+
+unsigned long MemoryPort::getBaudrate()
+{
+  return s_baudrate;
+}
+
+uint16_t MemoryPort::getConfig()
+{
+  return s_config;
+}
+
+uint32_t MemoryPort::getLostRxCount()
+{
+  return s_lostRxCount;
+}
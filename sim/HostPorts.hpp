@@ -0,0 +1,97 @@
+// ****************************************************************************
+/// \file      HostPorts.hpp
+///
+/// \brief     Port policies of the SerialHandler for Linux
+///
+/// \details   Same interface as UartPort (SerialPort.hpp), selected by a flag of
+///            the host build instead of Serial1:
+///            -DENCODER_TERMIOS_PORT: TermiosPort, a serial device (USB RS-485
+///            adapter) or the pty of ha40sim_pty, in real time (simSetRealTime).
+///            -DENCODER_MEMORY_PORT: MemoryPort, byte queues in memory. The host
+///            code injects the replies and takes the requests.
+///            Both run with UartDirection: a USB adapter switches the RS-485 driver
+///            itself, a pty or memory has none.
+///
+/// \author    Christoph Capiaghi
+///
+/// \version   0.1
+///
+/// \date      20221017
+///
+/// \copyright Licensed under the Apache License, Version 2.0 (the "License");
+/// you may not use this file except in compliance with the License.
+/// You may obtain a copy of the License at
+/// http://www.apache.org/licenses/LICENSE-2.0
+///
+/// \pre
+///
+/// \bug
+///
+/// \warning   Host only. One port of each kind, the members are static like the
+///            Uart of a UartPort.
+///
+/// \todo
+///
+
+// Prevent recursive inclusion
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+/// \brief Linux serial device or pty
+class TermiosPort
+{
+public:
+    static const uint16_t RX_BUFFER_SIZE = 4096;   /// Receive buffer of the tty layer
+
+    static bool open(const char* device);
+    static void close();
+
+    static void begin(const unsigned long baudrate, const uint16_t config);
+    static void end();
+    static int available();
+    static int read();
+    static size_t write(const uint8_t data[], const size_t length);
+    static void flush();
+
+private:
+    static const uint16_t READ_CHUNK = 256;
+
+    static int s_fd;                        /// -1: not open
+    static uint8_t s_chunk[READ_CHUNK];     /// Read from the device, not yet taken
+    static uint16_t s_chunkOffset;
+    static uint16_t s_chunkLength;
+};
+
+/// \brief Byte queues in memory, e.g. for host checks of the encoder stack
+class MemoryPort
+{
+public:
+    static const uint16_t RX_BUFFER_SIZE = 256;    /// Same as Serial1 of the SAMD51 core
+    static const uint16_t TX_BUFFER_SIZE = 1024;
+
+    static void begin(const unsigned long baudrate, const uint16_t config);
+    static void end();
+    static int available();
+    static int read();
+    static size_t write(const uint8_t data[], const size_t length);
+    static void flush();
+
+    static size_t inject(const uint8_t data[], const size_t length);
+    static size_t takeTx(uint8_t data[], const size_t maxLength);
+    static void clear();
+    static unsigned long getBaudrate();
+    static uint16_t getConfig();
+    static uint32_t getLostRxCount();
+
+private:
+    static uint8_t  s_rxBuffer[RX_BUFFER_SIZE];
+    static uint16_t s_rxHead;
+    static uint16_t s_rxCount;
+    static uint8_t  s_txBuffer[TX_BUFFER_SIZE];
+    static uint16_t s_txCount;
+    static unsigned long s_baudrate;        /// Of the last begin()
+    static uint16_t s_config;
+    static uint32_t s_lostRxCount;          /// Injected bytes lost, receive buffer full
+};
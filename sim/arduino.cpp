@@ -0,0 +1,465 @@
+// ****************************************************************************
+/// \file      arduino.cpp
+///
+/// \brief     Minimal Arduino core for the host simulation
+///
+/// \details   Virtual or real-time clock, GPIO stubs, debug port, the simulated encoder link
+///            and the host backend of Rs485Hal
+///
+/// \author    Christoph Capiaghi
+///
+/// \version   0.1
+///
+/// \date      20221017
+///
+/// \copyright Licensed under the Apache License, Version 2.0 (the "License");
+/// you may not use this file except in compliance with the License.
+/// You may obtain a copy of the License at
+/// http://www.apache.org/licenses/LICENSE-2.0
+///
+/// \pre
+///
+/// \bug
+///
+/// \warning   A baud rate mismatch between Serial1 and the simulator delivers
+///            inverted bytes, like the garbage of a real UART.
+///
+/// \todo
+///
+
+#include <time.h>
+#include <unistd.h>
+#include "arduino.h"
+#include "HA40Simulator.hpp"
+#include "CaptureReplay.hpp"
+#include "../Rs485Direction.hpp"
+
+static uint32_t s_timeUs     = 0;
+static uint32_t s_callCostUs = 1;   /// Virtual time of one micros() / available() call
+static bool     s_realTime   = false; /// Clock of the host instead of virtual time
+static uint8_t  s_triggerPin  = 0xFF;           /// Pin wired to the trigger input of the simulator
+static HA40Simulator* s_triggerSimulator = 0;
+
+static bool     s_timerArmed     = false;       /// Turnaround timer of Rs485Hal
+static uint32_t s_timerDueUs     = 0;
+static uint8_t  s_txEnablePin    = 0xFF;        /// Monitored driver enable pin
+static bool     s_driverEnabled  = false;
+static uint32_t s_driverOnUs     = 0;           /// Last rising edge
+static uint32_t s_driverOffUs    = 0;           /// Last falling edge
+static sim_rs485_stats_t s_rs485Stats;
+
+SimDebugSerial Serial;
+SimSerial Serial1;
+
+static uint32_t getRealTimeUs()
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint32_t)(now.tv_sec * 1000000ULL + now.tv_nsec / 1000);
+}
+
+/// <summary>
+/// Advances the virtual time, or reads the host clock in real time. A timer which
+/// expires meanwhile interrupts at its due time, the interrupted code continues
+/// afterwards.
+/// </summary>
+static void advance(const uint32_t us)
+{
+  uint32_t nowUs = s_realTime ? getRealTimeUs() : s_timeUs + us;
+  while (s_timerArmed && (int32_t)(nowUs - s_timerDueUs) >= 0)
+  {
+    s_timerArmed = false;
+    s_timeUs     = s_timerDueUs;
+    Rs485Direction::timerInterrupt(); // May start the timer again
+  }
+  s_timeUs = nowUs;
+}
+
+uint32_t simGetTimeUs()
+{
+  return s_timeUs;
+}
+
+void simAdvanceUs(const uint32_t us)
+{
+  advance(us);
+}
+
+void simSetCallCostUs(const uint32_t us)
+{
+  s_callCostUs = us;
+}
+
+/// <summary>
+/// Real time: micros() is the host clock, delay() sleeps. For a link outside the
+/// process, e.g. TermiosPort. Set before the first micros() call.
+/// </summary>
+void simSetRealTime(const bool enable)
+{
+  s_realTime = enable;
+  if (s_realTime) s_timeUs = getRealTimeUs();
+}
+
+/// <summary>
+/// delay(): sleeps in real time
+/// </summary>
+static void wait(const uint32_t us)
+{
+  if (s_realTime) usleep(us);
+  advance(us);
+}
+
+uint32_t micros()
+{
+  advance(s_callCostUs);
+  return s_timeUs;
+}
+
+uint32_t millis()
+{
+  return micros() / 1000;
+}
+
+void delay(uint32_t ms)
+{
+  wait(ms * 1000);
+}
+
+void delayMicroseconds(uint32_t us)
+{
+  wait(us);
+}
+
+void pinMode(uint8_t, uint8_t)
+{
+}
+
+void digitalWrite(uint8_t pin, uint8_t value)
+{
+  if (pin == s_triggerPin && s_triggerSimulator) s_triggerSimulator->setTriggerInput(value != LOW, s_timeUs);
+  if (pin != s_txEnablePin || (value != LOW) == s_driverEnabled) return;
+
+  s_driverEnabled = (value != LOW);
+  if (s_driverEnabled)
+  {
+    s_driverOnUs = s_timeUs;
+    s_rs485Stats.frames++;
+    return;
+  }
+  s_driverOffUs = s_timeUs;
+  int32_t holdUs = (int32_t)(s_timeUs - Serial1.getLineFreeTimeUs());
+  if (holdUs < 0)
+  {
+    s_rs485Stats.truncatedFrames++;
+    return;
+  }
+  s_rs485Stats.turnarounds++;
+  s_rs485Stats.totalHoldUs += holdUs;
+  if ((uint32_t)holdUs > s_rs485Stats.maxHoldUs) s_rs485Stats.maxHoldUs = holdUs;
+}
+
+void simSetTriggerPin(const uint8_t pin, HA40Simulator* simulator)
+{
+  s_triggerPin       = pin;
+  s_triggerSimulator = simulator;
+}
+
+int digitalRead(uint8_t)
+{
+  return HIGH;
+}
+
+void simSetTxEnablePin(const uint8_t pin)
+{
+  s_txEnablePin   = pin;
+  s_driverEnabled = false;
+  s_rs485Stats    = sim_rs485_stats_t();
+}
+
+sim_rs485_stats_t simGetRs485Stats()
+{
+  return s_rs485Stats;
+}
+
+/// <summary>
+/// true if the driver was on at any time from startUs to endUs
+/// </summary>
+static bool isDriverOn(const uint32_t startUs, const uint32_t endUs)
+{
+  if ((int32_t)(s_driverOnUs - endUs) >= 0) return false;
+  return s_driverEnabled || (int32_t)(s_driverOffUs - startUs) > 0;
+}
+
+// ----------------------------------------------------------------------------
+// Rs485Hal: turnaround timer in virtual time, transmitter state of Serial1
+
+void Rs485Hal::initialize()
+{
+}
+
+void Rs485Hal::startTimer(const uint32_t delayUs)
+{
+  s_timerDueUs = s_timeUs + delayUs;
+  s_timerArmed = true;
+}
+
+void Rs485Hal::stopTimer()
+{
+  s_timerArmed = false;
+}
+
+bool Rs485Hal::isTransmitterIdle()
+{
+  return Serial1.isTransmitComplete();
+}
+
+// ----------------------------------------------------------------------------
+// Debug port
+
+SimDebugSerial::SimDebugSerial() : m_enabled(false)
+{
+}
+
+void SimDebugSerial::setEnabled(const bool enable)
+{
+  m_enabled = enable;
+}
+
+void SimDebugSerial::begin(unsigned long)
+{
+}
+
+SimDebugSerial::operator bool()
+{
+  return true;
+}
+
+void SimDebugSerial::print(const char* text)
+{
+  if (m_enabled) fputs(text, stderr);
+}
+
+void SimDebugSerial::print(char value)
+{
+  if (m_enabled) fputc(value, stderr);
+}
+
+void SimDebugSerial::print(long value, int base)
+{
+  if (m_enabled) fprintf(stderr, (base == HEX) ? "%lX" : "%ld", value);
+}
+
+void SimDebugSerial::print(unsigned long value, int base)
+{
+  if (m_enabled) fprintf(stderr, (base == HEX) ? "%lX" : "%lu", value);
+}
+
+void SimDebugSerial::print(double value, int digits)
+{
+  if (m_enabled) fprintf(stderr, "%.*f", digits, value);
+}
+
+void SimDebugSerial::println()
+{
+  if (m_enabled) fputc('\n', stderr);
+}
+
+// ----------------------------------------------------------------------------
+// Encoder link
+
+SimSerial::SimSerial() : m_numberOfSimulators(0),
+  m_replay(0),
+  m_baudrate(9600),
+  m_config(SERIAL_8N1),
+  m_lineFreeTimeUs(0),
+  m_rxHead(0),
+  m_rxCount(0),
+  m_lostRxCount(0)
+{
+}
+
+void SimSerial::attach(HA40Simulator* simulator)
+{
+  m_simulators[0]      = simulator;
+  m_numberOfSimulators = 1;
+  m_replay             = 0;
+}
+
+void SimSerial::attach(CaptureReplay* replay)
+{
+  m_replay             = replay;
+  m_numberOfSimulators = 0;
+}
+
+/// <summary>
+/// One more simulator on the bus. Give each its own slaveAddress: replies of two
+/// simulators at the same time are not modelled as a collision.
+/// </summary>
+/// <returns>false if the bus is full</returns>
+bool SimSerial::addSimulator(HA40Simulator* simulator)
+{
+  if (m_numberOfSimulators >= MAX_SIMULATORS) return false;
+  m_simulators[m_numberOfSimulators++] = simulator;
+  m_replay = 0;
+  return true;
+}
+
+void SimSerial::begin(unsigned long baudrate, uint16_t config)
+{
+  m_baudrate = baudrate;
+  m_config   = config;
+}
+
+void SimSerial::end()
+{
+}
+
+SimSerial::operator bool()
+{
+  return true;
+}
+
+int SimSerial::available()
+{
+  advance(s_callCostUs);
+  receiveFromSimulator();
+  return m_rxCount;
+}
+
+int SimSerial::read()
+{
+  receiveFromSimulator();
+  if (m_rxCount == 0) return -1;
+  uint8_t data = m_rxBuffer[m_rxHead];
+  m_rxHead = (m_rxHead + 1) % RX_BUFFER_SIZE;
+  m_rxCount--;
+  return data;
+}
+
+/// <summary>
+/// Stream::readBytes(): waits up to 1 s for each byte
+/// </summary>
+size_t SimSerial::readBytes(uint8_t* buffer, size_t length)
+{
+  size_t count = 0;
+  uint32_t startUs = s_timeUs;
+  while (count < length && (s_timeUs - startUs) < 1000000UL)
+  {
+    int data = read();
+    if (data < 0)
+    {
+      advance(s_callCostUs);
+      continue;
+    }
+    buffer[count++] = (uint8_t)data;
+    startUs = s_timeUs;
+  }
+  return count;
+}
+
+/// <summary>
+/// Queues the byte on the line. The simulator sees it when its stop bit is out,
+/// the parity bit (if any) is what the encoder samples as 9th bit. With a monitored
+/// driver enable pin, a byte written while the driver is off does not reach the bus.
+/// </summary>
+size_t SimSerial::write(uint8_t data)
+{
+  if ((int32_t)(s_timeUs - m_lineFreeTimeUs) > 0) m_lineFreeTimeUs = s_timeUs;
+  m_lineFreeTimeUs += getCharTimeUs();
+  if (s_txEnablePin != 0xFF && !s_driverEnabled)
+  {
+    s_rs485Stats.undrivenBytes++;
+    return 1;
+  }
+
+  uint8_t ones = 0;
+  for (uint8_t bits = data; bits; bits >>= 1) ones += bits & 0x01;
+  bool ninthBit = false;
+  if (m_config == SERIAL_8O1) ninthBit = (ones % 2) == 0;
+  if (m_config == SERIAL_8E1) ninthBit = (ones % 2) == 1;
+
+  for (uint8_t i = 0; i < m_numberOfSimulators; i++)
+  {
+    m_simulators[i]->receive(data, ninthBit, m_baudrate, m_lineFreeTimeUs);
+  }
+  if (m_replay) m_replay->receive(data, s_timeUs); // Time of the call, like BusCapture
+  return 1;
+}
+
+size_t SimSerial::write(const uint8_t* data, size_t length)
+{
+  for (size_t i = 0; i < length; i++)
+  {
+    write(data[i]);
+  }
+  return length;
+}
+
+/// <summary>
+/// Returns when the last stop bit is out
+/// </summary>
+void SimSerial::flush()
+{
+  if ((int32_t)(m_lineFreeTimeUs - s_timeUs) > 0) advance(m_lineFreeTimeUs - s_timeUs);
+}
+
+bool SimSerial::isTransmitComplete()
+{
+  return (int32_t)(s_timeUs - m_lineFreeTimeUs) >= 0;
+}
+
+uint32_t SimSerial::getLostRxCount()
+{
+  return m_lostRxCount;
+}
+
+/// <summary>
+/// End of the last stop bit sent
+/// </summary>
+uint32_t SimSerial::getLineFreeTimeUs()
+{
+  return m_lineFreeTimeUs;
+}
+
+void SimSerial::receiveFromSimulator()
+{
+  uint8_t data;
+  while (m_replay && m_replay->transmit(s_timeUs, data))
+  {
+    if (m_rxCount == RX_BUFFER_SIZE - 1) // Full like the ring of the core, byte lost
+    {
+      m_lostRxCount++;
+      continue;
+    }
+    m_rxBuffer[(m_rxHead + m_rxCount) % RX_BUFFER_SIZE] = data;
+    m_rxCount++;
+  }
+  for (uint8_t i = 0; i < m_numberOfSimulators; i++)
+  {
+    HA40Simulator* simulator = m_simulators[i];
+    bool baudrateMatch = (simulator->getBaudrate() == m_baudrate);
+    while (simulator->isTransmitPending())
+    {
+      uint32_t endUs = simulator->getNextTransmitTimeUs();
+      if (!simulator->transmit(s_timeUs, data)) break;
+      if (s_txEnablePin != 0xFF && isDriverOn(endUs - getCharTimeUs(), endUs))
+      {
+        s_rs485Stats.lostRxBytes++; // Receiver off, and both ends drive the bus
+        continue;
+      }
+      if (m_rxCount == RX_BUFFER_SIZE - 1) // Full like the ring of the core, byte lost
+      {
+        m_lostRxCount++;
+        continue;
+      }
+      m_rxBuffer[(m_rxHead + m_rxCount) % RX_BUFFER_SIZE] = baudrateMatch ? data : (uint8_t)~data;
+      m_rxCount++;
+    }
+  }
+}
+
+uint32_t SimSerial::getCharTimeUs()
+{
+  uint8_t bits = (m_config == SERIAL_8N1) ? 10 : 11;
+  return (bits * 1000000UL + m_baudrate - 1) / m_baudrate;
+}
@@ -0,0 +1,165 @@
+// ****************************************************************************
+/// \file      arduino.h
+///
+/// \brief     Minimal Arduino core for the host simulation
+///
+/// \details   Just enough of the core to build Encoder, EncoderBus, SerialHandler
+///            and RomerFrameParser on Linux. Time is virtual: micros() advances by
+///            a fixed cost per call, so busy-wait loops terminate and every run is
+///            reproducible; simSetRealTime() switches to the host clock for a
+///            link outside the process (TermiosPort). Serial1 is wired to an
+///            HA40Simulator, Serial (debug port) prints to stderr when enabled.
+///            The Rs485Hal backend of the host lives here too: its turnaround timer
+///            interrupts the code at its due virtual time, and the driver enable
+///            pin is checked against the line.
+///
+/// \author    Christoph Capiaghi
+///
+/// \version   0.1
+///
+/// \date      20221017
+///
+/// \copyright Licensed under the Apache License, Version 2.0 (the "License");
+/// you may not use this file except in compliance with the License.
+/// You may obtain a copy of the License at
+/// http://www.apache.org/licenses/LICENSE-2.0
+///
+/// \pre
+///
+/// \bug
+///
+/// \warning   Host only, found first by -Isim. Not used by the Arduino build.
+///
+/// \todo
+///
+
+// Prevent recursive inclusion
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+
+#define HIGH          1
+#define LOW           0
+#define INPUT         0
+#define OUTPUT        1
+#define INPUT_PULLUP  2
+#define A0            14
+#define A1            15
+#define A2            16
+#define A3            17
+#define A4            18
+#define SERIAL_8N1    0x13
+#define SERIAL_8E1    0x23
+#define SERIAL_8O1    0x33
+#define SERIAL_BUFFER_SIZE 256   /// Receive buffer of Serial1, same as the SAMD51 core
+#define DEC           10
+#define HEX           16
+#define F(string)     (string)
+#define PI            3.1415926535897932384626433832795
+
+uint32_t micros();
+uint32_t millis();
+void delay(uint32_t ms);
+void delayMicroseconds(uint32_t us);
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+int digitalRead(uint8_t pin);
+
+// Virtual time
+uint32_t simGetTimeUs();
+void simAdvanceUs(const uint32_t us);
+void simSetCallCostUs(const uint32_t us);
+void simSetRealTime(const bool enable);
+
+class HA40Simulator;
+class CaptureReplay;
+
+// GPIO wired to the simulator
+void simSetTriggerPin(const uint8_t pin, HA40Simulator* simulator);
+
+/// \brief RS-485 turnaround, checked against the simulated line
+typedef struct sim_rs485_stats_s
+{
+  uint32_t frames;            /// Driver enable rising edges
+  uint32_t turnarounds;       /// Driver enable falling edges after a complete frame
+  uint32_t truncatedFrames;   /// Driver off before the last stop bit was out
+  uint32_t undrivenBytes;     /// Bytes written with the driver off, not on the bus
+  uint32_t lostRxBytes;       /// Reply bytes on the line while the driver was on, lost
+  uint32_t maxHoldUs;         /// Longest time from the last stop bit to driver off
+  uint64_t totalHoldUs;
+} sim_rs485_stats_t;
+
+// Driver enable pin of the transceiver, monitored from now on
+void simSetTxEnablePin(const uint8_t pin);
+sim_rs485_stats_t simGetRs485Stats();
+
+/// \brief Debug port: stderr, quiet by default
+class SimDebugSerial
+{
+public:
+    SimDebugSerial();
+    void setEnabled(const bool enable);
+    void begin(unsigned long baudrate);
+    operator bool();
+
+    void print(const char* text);
+    void print(char value);
+    void print(long value, int base = DEC);
+    void print(unsigned long value, int base = DEC);
+    void print(int value, int base = DEC)          { print((long)value, base); }
+    void print(unsigned int value, int base = DEC) { print((unsigned long)value, base); }
+    void print(double value, int digits = 2);
+    template<class T> void println(T value)             { print(value); println(); }
+    template<class T> void println(T value, int format) { print(value, format); println(); }
+    void println();
+
+private:
+    bool m_enabled;
+};
+
+/// \brief Encoder link: bytes go to the simulator with their time on the line,
+///        or to the replay of a capture. Several addressed simulators make a multi-drop bus.
+class SimSerial
+{
+public:
+    SimSerial();
+    void attach(HA40Simulator* simulator);
+    void attach(CaptureReplay* replay);
+    bool addSimulator(HA40Simulator* simulator);
+    void begin(unsigned long baudrate, uint16_t config = SERIAL_8N1);
+    void end();
+    operator bool();
+
+    int available();
+    int read();
+    size_t readBytes(uint8_t* buffer, size_t length);
+    size_t write(uint8_t data);
+    size_t write(const uint8_t* data, size_t length);
+    void flush();
+    bool isTransmitComplete();
+    uint32_t getLineFreeTimeUs();
+    uint32_t getLostRxCount();
+
+private:
+    static const uint16_t RX_BUFFER_SIZE = SERIAL_BUFFER_SIZE;
+    static const uint8_t  MAX_SIMULATORS = 8;
+
+    HA40Simulator* m_simulators[MAX_SIMULATORS];  /// Encoders on the bus, each sees every request
+    uint8_t m_numberOfSimulators;
+    CaptureReplay* m_replay;
+    unsigned long m_baudrate;
+    uint16_t m_config;
+    uint32_t m_lineFreeTimeUs;       /// End of the last byte sent
+    uint8_t  m_rxBuffer[RX_BUFFER_SIZE];
+    uint16_t m_rxHead;
+    uint16_t m_rxCount;
+    uint32_t m_lostRxCount;          /// Bytes lost, receive buffer full
+
+    void receiveFromSimulator();
+    uint32_t getCharTimeUs();
+};
+
+extern SimDebugSerial Serial;
+extern SimSerial Serial1;
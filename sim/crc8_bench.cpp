@@ -0,0 +1,152 @@
+// ****************************************************************************
+/// \file      crc8_bench.cpp
+///
+/// \brief     CRC8 variants: equivalence with crc8.c and speed
+///
+/// \details   Checks Crc8::update / compute / computeSlice4 / computeSlice8 bit
+///            exact against CSV_CalcCRC8_Add for every length 0 ... 300 at every
+///            alignment 0 ... 7 and with a running CRC, then measures the time per
+///            byte for Romer frame sizes and bulk sizes. Exit code 1 on a mismatch.
+///            Build and options: see sim/README.md
+///
+/// \author    Christoph Capiaghi
+///
+/// \version   0.1
+///
+/// \date      20221017
+///
+/// \copyright Licensed under the Apache License, Version 2.0 (the "License");
+/// you may not use this file except in compliance with the License.
+/// You may obtain a copy of the License at
+/// http://www.apache.org/licenses/LICENSE-2.0
+///
+/// \pre
+///
+/// \bug
+///
+/// \warning   Host timing, use it to compare the variants, not as target timing
+///
+/// \todo
+///
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../Crc8.hpp"
+extern "C" {
+#include "../crc8.h"
+}
+
+static const uint32_t MAX_CHECK_LENGTH = 300;
+static const uint32_t BUFFER_SIZE      = 65536 + 8;
+static const uint32_t BENCH_BYTES      = 64UL * 1024 * 1024;   /// Bytes per variant and size
+
+typedef uint8_t (*crc8_function_t)(const uint8_t data[], uint32_t length, uint8_t crc);
+
+static uint8_t crcReference(const uint8_t data[], uint32_t length, uint8_t crc)
+{
+  return CSV_CalcCRC8_Add(data, length, crc);
+}
+
+static uint8_t crcUpdate(const uint8_t data[], uint32_t length, uint8_t crc)
+{
+  for (uint32_t i = 0; i < length; i++) crc = Crc8::update(crc, data[i]);
+  return crc;
+}
+
+static uint8_t crcCompute(const uint8_t data[], uint32_t length, uint8_t crc)
+{
+  return Crc8::compute(data, length, crc);
+}
+
+static uint8_t crcSlice4(const uint8_t data[], uint32_t length, uint8_t crc)
+{
+  return Crc8::computeSlice4(data, length, crc);
+}
+
+static uint8_t crcSlice8(const uint8_t data[], uint32_t length, uint8_t crc)
+{
+  return Crc8::computeSlice8(data, length, crc);
+}
+
+static const struct
+{
+  const char* name;
+  crc8_function_t function;
+} VARIANTS[] =
+{
+  { "crc8.c",  crcReference },
+  { "update",  crcUpdate },
+  { "compute", crcCompute },
+  { "slice4",  crcSlice4 },
+  { "slice8",  crcSlice8 },
+};
+static const uint8_t NUMBER_OF_VARIANTS = sizeof(VARIANTS) / sizeof(VARIANTS[0]);
+
+static double nowNs()
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec * 1e9 + now.tv_nsec;
+}
+
+int main(int argc, char* argv[])
+{
+  uint32_t benchBytes = (argc > 1) ? strtoul(argv[1], 0, 0) : BENCH_BYTES;
+  static uint8_t buffer[BUFFER_SIZE];
+  uint32_t random = 1;
+  for (uint32_t i = 0; i < BUFFER_SIZE; i++)
+  {
+    random ^= random << 13; random ^= random >> 17; random ^= random << 5; // xorshift32
+    buffer[i] = (uint8_t)random;
+  }
+
+  // Equivalence: every variant, length, alignment, start value
+  uint32_t mismatches = 0;
+  if (!Crc8::selfTest()) mismatches++;
+  for (uint32_t offset = 0; offset < 8; offset++)
+  {
+    for (uint32_t length = 0; length <= MAX_CHECK_LENGTH; length++)
+    {
+      uint8_t start = (uint8_t)(length * 7 + offset);
+      uint8_t expected = CSV_CalcCRC8_Add(buffer + offset, length, start);
+      for (uint8_t v = 1; v < NUMBER_OF_VARIANTS; v++)
+      {
+        if (VARIANTS[v].function(buffer + offset, length, start) != expected)
+        {
+          if (mismatches++ < 10) printf("Mismatch: %s offset %lu length %lu\n", VARIANTS[v].name, (unsigned long)offset, (unsigned long)length);
+        }
+      }
+    }
+  }
+  printf("Equivalence with crc8.c: %s\n", mismatches ? "FAIL" : "ok");
+
+  // Speed: Romer frames (5, 9, 44 bytes) and bulk data
+  static const uint32_t SIZES[] = { 5, 9, 44, 256, 4096, 65536 };
+  printf("%8s", "bytes");
+  for (uint8_t v = 0; v < NUMBER_OF_VARIANTS; v++) printf("%10s", VARIANTS[v].name);
+  printf("   (ns/byte)\n");
+  volatile uint8_t sink = 0;
+  for (uint8_t s = 0; s < sizeof(SIZES) / sizeof(SIZES[0]); s++)
+  {
+    uint32_t size = SIZES[s];
+    uint32_t repetitions = benchBytes / size + 1;
+    printf("%8lu", (unsigned long)size);
+    for (uint8_t v = 0; v < NUMBER_OF_VARIANTS; v++)
+    {
+      uint8_t crc = 0;
+      double startNs = nowNs();
+      for (uint32_t r = 0; r < repetitions; r++)
+      {
+        crc = VARIANTS[v].function(buffer + (r & 7), size, crc);
+      }
+      double ns = nowNs() - startNs;
+      sink ^= crc;
+      printf("%10.3f", ns / ((double)repetitions * size));
+    }
+    printf("\n");
+  }
+  (void)sink;
+  return mismatches ? 1 : 0;
+}
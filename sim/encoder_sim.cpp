@@ -0,0 +1,584 @@
+// ****************************************************************************
+/// \file      encoder_sim.cpp
+///
+/// \brief     Runs the real Encoder / SerialHandler against the HA40+ simulator
+///
+/// \details   Power-up (parity trick), then N samples through getRawAngle() like
+///            the main loop. Reports throughput, sample age and the angle error
+///            at the capture timestamp in virtual time. The RS-485 driver enable pin
+///            is checked against the line. Exit code 1 if the encoder does not come
+///            up, if no sample is valid, if the timestamp error exceeds
+///            --max-error-arcsec, if the turnaround truncates or loses bytes or if
+///            the encoder lost its baud rate or trigger mode after an outage.
+///            --bus: several addressed simulators on one bus, polled by EncoderBus.
+///            Build and options: see sim/README.md
+///
+/// \author    Christoph Capiaghi
+///
+/// \version   0.1
+///
+/// \date      20221017
+///
+/// \copyright Licensed under the Apache License, Version 2.0 (the "License");
+/// you may not use this file except in compliance with the License.
+/// You may obtain a copy of the License at
+/// http://www.apache.org/licenses/LICENSE-2.0
+///
+/// \pre
+///
+/// \bug
+///
+/// \warning
+///
+/// \todo
+///
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "arduino.h"
+#include "HA40Simulator.hpp"
+#include "CaptureReplay.hpp"
+#include "../Encoder.hpp"
+#include "../SerialHandler.hpp"
+#include "../EncoderSampler.hpp"
+#include "../EncoderBus.hpp"
+#include "../Angle.hpp"
+#include "../Crc8.hpp"
+#include "../config.hpp"
+
+static const uint32_t CAPTURE_BUFFER_SIZE = 16UL * 1024 * 1024;   /// Bytes, --capture
+
+/// <summary>
+/// Like Safe::update(): restores the encoder after a power cycle, the timer stopped meanwhile
+/// </summary>
+static void restoreEncoder(Encoder& encoder, EncoderSampler& sampler, uint32_t& restoreCount)
+{
+  if (!encoder.isRestorePending() || encoder.isDegraded()) return;
+  bool sampling = sampler.isRunning();
+  sampler.stop();
+  if (encoder.restoreConfiguration() == RC_OK) restoreCount++;
+  if (sampling) sampler.start();
+}
+
+/// <summary>
+/// --bus: one simulator per priority at the slave addresses 1, 2, ..., scheduled by an
+/// EncoderBus. The knobs start spread over the circle, so a reply taken from the wrong
+/// slave shows up as an angle error. Checks the poll shares against the priorities.
+/// </summary>
+/// <returns>Exit code</returns>
+static int runBus(const ha40sim_config_t& config, const uint8_t priorities[], const uint8_t numberOfEncoders,
+                  const uint8_t anglesPerRequest, const uint32_t numberOfSamples, const uint32_t loopUs,
+                  const double maxErrorArcSec)
+{
+  HA40Simulator simulators[EncoderBus::MAX_NUMBER_OF_ENCODERS];
+  Encoder encoders[EncoderBus::MAX_NUMBER_OF_ENCODERS];
+  uint32_t lastSampleCount[EncoderBus::MAX_NUMBER_OF_ENCODERS];
+  uint32_t validSamples[EncoderBus::MAX_NUMBER_OF_ENCODERS];
+  uint32_t maxErrorRaw[EncoderBus::MAX_NUMBER_OF_ENCODERS];
+  SerialHandler serialHandler;
+  EncoderBus bus;
+
+  for (uint8_t i = 0; i < numberOfEncoders; i++)
+  {
+    ha40sim_config_t deviceConfig = config;
+    deviceConfig.slaveAddress  = i + 1;
+    deviceConfig.seed          = config.seed + i;
+    deviceConfig.startAngleDeg = config.startAngleDeg + 360.0 * i / numberOfEncoders;
+    simulators[i].initialize(deviceConfig);
+    Serial1.addSimulator(&simulators[i]);
+    if (bus.addEncoder(&encoders[i], i + 1, priorities[i]) != RC_OK)
+    {
+      printf("FAIL: addEncoder %u\n", i + 1);
+      return 2;
+    }
+  }
+  simSetTxEnablePin(TX_ENABLE_PIN);
+  serialHandler.initialize();
+
+  uint32_t startUs = simGetTimeUs();
+  bus.initialize(&serialHandler); // A failed first sample is not fatal, a silent encoder is
+  for (uint8_t i = 0; i < numberOfEncoders; i++)
+  {
+    if (encoders[i].isDegraded())
+    {
+      printf("FAIL: encoder init, address: %u\n", encoders[i].getDeviceAddress());
+      return 1;
+    }
+  }
+  printf("Init: %lu us, %u encoders\n", (unsigned long)(simGetTimeUs() - startUs), numberOfEncoders);
+
+  uint32_t totalSamples = 0;
+  for (uint8_t i = 0; i < numberOfEncoders; i++)
+  {
+    encoders[i].setAnglesPerRequest(anglesPerRequest);
+    lastSampleCount[i] = encoders[i].getSampleCount();
+    validSamples[i]    = 0;
+    maxErrorRaw[i]     = 0;
+  }
+  startUs = simGetTimeUs();
+  while (totalSamples < numberOfSamples && (simGetTimeUs() - startUs) < 60000000UL)
+  {
+    bus.update();
+    for (uint8_t i = 0; i < numberOfEncoders; i++)
+    {
+      if (encoders[i].getSampleCount() == lastSampleCount[i]) continue;
+      lastSampleCount[i] = encoders[i].getSampleCount();
+      encoder_sample_t samples[Encoder::ROMER_MAX_ANGLES_PER_REQUEST];
+      uint8_t batchLength = 0;
+      encoders[i].getAngleBatch(samples, Encoder::ROMER_MAX_ANGLES_PER_REQUEST, batchLength);
+      for (uint8_t n = 0; n < batchLength; n++)
+      {
+        uint32_t errorRaw = angleRawDistance(samples[n].rawAngle, simulators[i].getTrueRawAngle(samples[n].timestampUs));
+        if (errorRaw > maxErrorRaw[i]) maxErrorRaw[i] = errorRaw;
+        validSamples[i]++;
+        totalSamples++;
+      }
+    }
+    simAdvanceUs(loopUs);
+  }
+
+  uint32_t elapsedUs = simGetTimeUs() - startUs;
+  uint32_t totalPolls = 0;
+  uint16_t totalPriority = 0;
+  for (uint8_t i = 0; i < numberOfEncoders; i++)
+  {
+    totalPolls    += bus.getPollCount(i);
+    totalPriority += priorities[i];
+  }
+  printf("Samples: %lu in %lu us (%.1f samples/s), polls: %lu\n", (unsigned long)totalSamples, (unsigned long)elapsedUs,
+         elapsedUs ? totalSamples * 1e6 / elapsedUs : 0.0, (unsigned long)totalPolls);
+
+  bool shareFailed = false;
+  bool addressFailed = false;
+  bool errorFailed = false;
+  for (uint8_t i = 0; i < numberOfEncoders; i++)
+  {
+    const encoder_link_stats_t& stats = encoders[i].getLinkStats();
+    double expectedPolls = (double)totalPolls * priorities[i] / totalPriority;
+    double share = totalPolls ? 100.0 * bus.getPollCount(i) / totalPolls : 0.0;
+    printf("Address %u: priority %u, polls %lu (%.1f %%, expected %.1f %%), samples %lu, transactions %lu, errors %lu, "
+           "address errors %lu, max error arcsec %lu, simulator requests %lu replies %lu\n",
+           i + 1, priorities[i], (unsigned long)bus.getPollCount(i), share, 100.0 * priorities[i] / totalPriority,
+           (unsigned long)validSamples[i], (unsigned long)stats.transactions, (unsigned long)stats.errors,
+           (unsigned long)stats.addressErrors, (unsigned long)angleRawToArcSeconds(maxErrorRaw[i]),
+           (unsigned long)simulators[i].getRequestCount(), (unsigned long)simulators[i].getReplyCount());
+    // Smooth weighted round-robin: off by less than one poll per encoder at any time
+    if (bus.getPollCount(i) + numberOfEncoders < expectedPolls || bus.getPollCount(i) > expectedPolls + numberOfEncoders) shareFailed = true;
+    if (stats.addressErrors > 0 || validSamples[i] == 0) addressFailed = true;
+    if (maxErrorArcSec >= 0.0 && angleRawToArcSeconds(maxErrorRaw[i]) > maxErrorArcSec) errorFailed = true;
+  }
+  sim_rs485_stats_t rs485 = simGetRs485Stats();
+  printf("RS-485: frames %lu, truncated %lu, undriven bytes %lu, lost reply bytes %lu\n", (unsigned long)rs485.frames,
+         (unsigned long)rs485.truncatedFrames, (unsigned long)rs485.undrivenBytes, (unsigned long)rs485.lostRxBytes);
+
+  if (shareFailed)
+  {
+    printf("FAIL: poll shares do not follow the priorities\n");
+    return 1;
+  }
+  if (addressFailed)
+  {
+    printf("FAIL: an encoder got no sample or a reply of another slave\n");
+    return 1;
+  }
+  if (errorFailed)
+  {
+    printf("FAIL: timestamp error above %.1f arcsec\n", maxErrorArcSec);
+    return 1;
+  }
+  if (rs485.truncatedFrames > 0 || rs485.undrivenBytes > 0 || rs485.lostRxBytes > 0)
+  {
+    printf("FAIL: RS-485 turnaround\n");
+    return 1;
+  }
+  printf("PASS\n");
+  return 0;
+}
+
+static void printUsage()
+{
+  printf("Usage: encoder_sim [options]\n"
+         "  --samples N            Samples to take (1000)\n"
+         "  --pipelined            Encoder pipeline mode\n"
+         "  --angles N             Angles per B command (1)\n"
+         "  --loop-us US           Main loop work per iteration (50)\n"
+         "  --timer-us US          Timer sampling (EncoderSampler) at this period (off)\n"
+         "  --frame-us US          Timer sampling: queue drained once per frame (22222)\n"
+         "  --hw-trigger-us US     Timer sampling: hardware trigger pulses at this period (off)\n"
+         "  --lead-us US           Hardware trigger: pulse locked this long before the frame (1000)\n"
+         "  --call-cost-us US      Virtual time per micros() call (1)\n"
+         "  --latency-us US        Encoder reply latency (150)\n"
+         "  --jitter-us US         Reply latency jitter (0)\n"
+         "  --velocity DEG_S       Knob rotation (0)\n"
+         "  --wobble DEG HZ        Sinusoidal knob motion (0 0)\n"
+         "  --noise COUNTS         Angle noise, standard deviation (0)\n"
+         "  --ber P                Bit error probability per reply byte (0)\n"
+         "  --drop P               Probability of a lost reply (0)\n"
+         "  --outage-ms START LEN  Encoder power loss, ms after power-up (off)\n"
+         "  --negotiate            negotiateBaudrate() after init, like ENCODER_HIGH_SPEED_LINK\n"
+         "  --bus P1,P2,...        One encoder per priority on one bus, polled by EncoderBus (off)\n"
+         "  --warm                 Encoder already in 8 bit mode\n"
+         "  --seed N               Random seed (1)\n"
+         "  --max-error-arcsec A   Fail above this timestamp error (off)\n"
+         "  --capture FILE         Record the link (BusCapture) into FILE\n"
+         "  --replay FILE          Encoder replies from a capture instead of the simulator\n"
+         "  --replay-fast          Replay: replies without the captured delay\n"
+         "  --stats                Encoder link statistics (printLinkStats) on stderr\n"
+         "  --debug                Debug output of the encoder classes on stderr\n");
+}
+
+int main(int argc, char* argv[])
+{
+  ha40sim_config_t config = HA40Simulator::getDefaultConfig();
+  uint32_t numberOfSamples = 1000;
+  bool pipelined = false;
+  uint8_t anglesPerRequest = 1;
+  uint32_t loopUs = 50;
+  double maxErrorArcSec = -1.0;
+  bool printStats = false;
+  uint32_t outageStartMs = 0;
+  uint32_t outageLengthMs = 0;
+  uint32_t timerUs = 0;
+  uint32_t frameUs = 22222;
+  uint32_t triggerUs = 0;
+  uint32_t leadUs = 1000;
+  const char* captureFile = 0;
+  const char* replayFile = 0;
+  bool replayFast = false;
+  bool negotiate = false;
+  uint8_t busPriorities[EncoderBus::MAX_NUMBER_OF_ENCODERS];
+  uint8_t busEncoders = 0;
+
+  for (int i = 1; i < argc; i++)
+  {
+    const char* arg = argv[i];
+    bool hasValue = (i + 1 < argc);
+    if      (!strcmp(arg, "--samples") && hasValue)      numberOfSamples = strtoul(argv[++i], 0, 0);
+    else if (!strcmp(arg, "--pipelined"))                pipelined = true;
+    else if (!strcmp(arg, "--angles") && hasValue)       anglesPerRequest = (uint8_t)strtoul(argv[++i], 0, 0);
+    else if (!strcmp(arg, "--loop-us") && hasValue)      loopUs = strtoul(argv[++i], 0, 0);
+    else if (!strcmp(arg, "--timer-us") && hasValue)     timerUs = strtoul(argv[++i], 0, 0);
+    else if (!strcmp(arg, "--frame-us") && hasValue)     frameUs = strtoul(argv[++i], 0, 0);
+    else if (!strcmp(arg, "--hw-trigger-us") && hasValue) triggerUs = strtoul(argv[++i], 0, 0);
+    else if (!strcmp(arg, "--lead-us") && hasValue)      leadUs = strtoul(argv[++i], 0, 0);
+    else if (!strcmp(arg, "--call-cost-us") && hasValue) simSetCallCostUs(strtoul(argv[++i], 0, 0));
+    else if (!strcmp(arg, "--latency-us") && hasValue)   config.replyLatencyUs = strtoul(argv[++i], 0, 0);
+    else if (!strcmp(arg, "--jitter-us") && hasValue)    config.latencyJitterUs = strtoul(argv[++i], 0, 0);
+    else if (!strcmp(arg, "--velocity") && hasValue)     config.velocityDegPerS = atof(argv[++i]);
+    else if (!strcmp(arg, "--wobble") && i + 2 < argc)
+    {
+      config.wobbleAmplitudeDeg = atof(argv[++i]);
+      config.wobbleFrequencyHz  = atof(argv[++i]);
+    }
+    else if (!strcmp(arg, "--noise") && hasValue)        config.noiseCounts = atof(argv[++i]);
+    else if (!strcmp(arg, "--ber") && hasValue)          config.byteErrorRate = atof(argv[++i]);
+    else if (!strcmp(arg, "--drop") && hasValue)         config.dropRate = atof(argv[++i]);
+    else if (!strcmp(arg, "--outage-ms") && i + 2 < argc)
+    {
+      outageStartMs  = strtoul(argv[++i], 0, 0);
+      outageLengthMs = strtoul(argv[++i], 0, 0);
+    }
+    else if (!strcmp(arg, "--negotiate"))                negotiate = true;
+    else if (!strcmp(arg, "--bus") && hasValue)
+    {
+      char* list = argv[++i];
+      busEncoders = 0;
+      while (*list && busEncoders < EncoderBus::MAX_NUMBER_OF_ENCODERS)
+      {
+        busPriorities[busEncoders++] = (uint8_t)strtoul(list, &list, 0);
+        if (*list == ',') list++;
+        else break;
+      }
+    }
+    else if (!strcmp(arg, "--warm"))                     config.startInEightBitMode = true;
+    else if (!strcmp(arg, "--seed") && hasValue)         config.seed = strtoul(argv[++i], 0, 0);
+    else if (!strcmp(arg, "--max-error-arcsec") && hasValue) maxErrorArcSec = atof(argv[++i]);
+    else if (!strcmp(arg, "--capture") && hasValue)      captureFile = argv[++i];
+    else if (!strcmp(arg, "--replay") && hasValue)       replayFile = argv[++i];
+    else if (!strcmp(arg, "--replay-fast"))              replayFast = true;
+    else if (!strcmp(arg, "--stats"))                    printStats = true;
+    else if (!strcmp(arg, "--debug"))                    Serial.setEnabled(true);
+    else
+    {
+      printUsage();
+      return 2;
+    }
+  }
+
+  config.outageStartUs  = outageStartMs * 1000UL;
+  config.outageLengthUs = outageLengthMs * 1000UL;
+  if (busEncoders > 0) return runBus(config, busPriorities, busEncoders, anglesPerRequest, numberOfSamples, loopUs, maxErrorArcSec);
+
+  HA40Simulator simulator;
+  simulator.initialize(config);
+  Serial1.attach(&simulator);
+
+  SerialHandler serialHandler;
+  Encoder encoder;
+  simSetTxEnablePin(TX_ENABLE_PIN);
+  serialHandler.initialize(); // RS-485 with ENCODER_RS485, same as rgbSafe.ino
+
+  // Capture from here, like rgbSafe.ino. The replay takes the place of the simulator.
+  BusCapture capture;
+  uint8_t* captureBuffer = 0;
+  if (captureFile)
+  {
+    captureBuffer = (uint8_t*)malloc(CAPTURE_BUFFER_SIZE);
+    capture.initialize(captureBuffer, CAPTURE_BUFFER_SIZE);
+    serialHandler.setCapture(&capture);
+    capture.start(serialHandler.getBaudrate());
+  }
+  CaptureReplay replay;
+  uint8_t* replayBuffer = 0;
+  if (replayFile)
+  {
+    FILE* file = fopen(replayFile, "rb");
+    if (!file)
+    {
+      printf("FAIL: cannot open %s\n", replayFile);
+      return 2;
+    }
+    fseek(file, 0, SEEK_END);
+    long length = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    replayBuffer = (uint8_t*)malloc(length > 0 ? length : 1);
+    size_t replayLength = fread(replayBuffer, 1, length > 0 ? length : 0, file);
+    fclose(file);
+    if (replay.initialize(replayBuffer, replayLength, simGetTimeUs(), replayFast) != RC_OK)
+    {
+      printf("FAIL: %s is no capture\n", replayFile);
+      return 2;
+    }
+    Serial1.attach(&replay);
+    printf("Replay: %lu bytes, crc8: %X\n", (unsigned long)replayLength, Crc8::computeSlice8(replayBuffer, replayLength));
+  }
+  struct timespec wallStart;
+  clock_gettime(CLOCK_MONOTONIC, &wallStart);
+
+  uint32_t startUs = simGetTimeUs();
+  uint8_t initErrorCode = encoder.initialize(&serialHandler);
+  if (encoder.isDegraded())
+  {
+    printf("FAIL: encoder init, ignored bytes: %lu\n", (unsigned long)simulator.getIgnoredByteCount());
+    return 1;
+  }
+  printf("Init: %lu us, 8 bit mode: %d, first sample: %u\n", (unsigned long)(simGetTimeUs() - startUs),
+         replayFile ? 1 : simulator.isEightBitMode(), initErrorCode);
+
+  unsigned long negotiatedBaudrate = serialHandler.getBaudrate();
+  if (negotiate)
+  {
+    encoder.negotiateBaudrate();
+    negotiatedBaudrate = serialHandler.getBaudrate();
+    printf("Negotiated: %lu bit/s\n", negotiatedBaudrate);
+  }
+  encoder.setAnglesPerRequest(anglesPerRequest);
+  encoder.setPipelineMode(pipelined);
+
+  // Timer sampling: the "interrupt" runs whenever virtual time passes the next tick
+  EncoderSampler sampler;
+  if (timerUs > 0)
+  {
+    if (sampler.initialize(&encoder, timerUs) != RC_OK)
+    {
+      printf("FAIL: timer period out of range\n");
+      return 2;
+    }
+    if (triggerUs > 0)
+    {
+      simSetTriggerPin(TRIGGER_PIN, &simulator);
+      if (sampler.setHardwareTrigger(TRIGGER_PIN, triggerUs) != RC_OK)
+      {
+        printf("FAIL: hardware trigger\n");
+        return 2;
+      }
+    }
+    sampler.start();
+  }
+  uint32_t nextTickUs = simGetTimeUs() + timerUs;
+  uint32_t nextFrameUs = simGetTimeUs() + frameUs;
+
+  uint32_t lastSampleCount = encoder.getSampleCount();
+  uint32_t validSamples = 0;
+  uint64_t sumAgeUs = 0;
+  uint32_t maxAgeUs = 0;
+  uint32_t maxErrorRaw = 0;
+  uint64_t sumErrorRaw = 0;
+  uint32_t iterations = 0;
+  uint32_t staleCalls = 0;
+  uint32_t maxCallUs = 0;
+  uint32_t restoreCount = 0;
+  startUs = simGetTimeUs();
+
+  while (timerUs > 0 && validSamples < numberOfSamples && (simGetTimeUs() - startUs) < 60000000UL)
+  {
+    if (replayFile && replay.isFinished() && !encoder.isBusy()) break;
+    if ((int32_t)(simGetTimeUs() - nextTickUs) >= 0)
+    {
+      uint32_t callStartUs = simGetTimeUs();
+      sampler.onTimer();
+      uint32_t callUs = simGetTimeUs() - callStartUs;
+      if (callUs > maxCallUs) maxCallUs = callUs;
+      nextTickUs += timerUs;
+    }
+    if ((int32_t)(simGetTimeUs() - nextFrameUs) >= 0)
+    {
+      encoder_sample_t sample;
+      while (sampler.pop(sample))
+      {
+        uint32_t ageUs = simGetTimeUs() - sample.timestampUs;
+        uint32_t errorRaw = replayFile ? 0 : angleRawDistance(sample.rawAngle, simulator.getTrueRawAngle(sample.timestampUs));
+        sumAgeUs    += ageUs;
+        sumErrorRaw += errorRaw;
+        if (ageUs > maxAgeUs) maxAgeUs = ageUs;
+        if (errorRaw > maxErrorRaw) maxErrorRaw = errorRaw;
+        validSamples++;
+      }
+      restoreEncoder(encoder, sampler, restoreCount);
+      sampler.lockToFrame(nextFrameUs, leadUs); // Like Safe::tick()
+      nextFrameUs += frameUs;
+      iterations++;
+    }
+    simAdvanceUs(1);
+  }
+
+  while (timerUs == 0 && validSamples < numberOfSamples && (simGetTimeUs() - startUs) < 60000000UL)
+  {
+    if (replayFile && replay.isFinished() && !encoder.isBusy()) break;
+    uint32_t rawAngle;
+    uint32_t callStartUs = simGetTimeUs();
+    if (encoder.getRawAngle(rawAngle) == RC_STALE) staleCalls++;
+    uint32_t callUs = simGetTimeUs() - callStartUs;
+    if (callUs > maxCallUs) maxCallUs = callUs;
+    iterations++;
+
+    if (encoder.getSampleCount() != lastSampleCount)
+    {
+      lastSampleCount = encoder.getSampleCount();
+      encoder_sample_t samples[Encoder::ROMER_MAX_ANGLES_PER_REQUEST];
+      uint8_t batchLength = 0;
+      if (encoder.getAngleBatch(samples, Encoder::ROMER_MAX_ANGLES_PER_REQUEST, batchLength) == RC_OK && batchLength > 0)
+      {
+        const encoder_sample_t& sample = samples[batchLength - 1]; // One bus call per iteration, like Safe::tick()
+        uint32_t ageUs = simGetTimeUs() - sample.timestampUs;
+        uint32_t errorRaw = replayFile ? 0 : angleRawDistance(sample.rawAngle, simulator.getTrueRawAngle(sample.timestampUs));
+        sumAgeUs    += ageUs;
+        sumErrorRaw += errorRaw;
+        if (ageUs > maxAgeUs) maxAgeUs = ageUs;
+        if (errorRaw > maxErrorRaw) maxErrorRaw = errorRaw;
+        validSamples++;
+      }
+    }
+    restoreEncoder(encoder, sampler, restoreCount);
+    simAdvanceUs(loopUs);
+  }
+
+  uint32_t elapsedUs = simGetTimeUs() - startUs;
+  printf("Samples: %lu in %lu us (%.1f samples/s), loop iterations: %lu\n",
+         (unsigned long)validSamples, (unsigned long)elapsedUs,
+         elapsedUs ? validSamples * 1e6 / elapsedUs : 0.0, (unsigned long)iterations);
+  if (validSamples == 0)
+  {
+    printf("FAIL: no valid sample\n");
+    return 1;
+  }
+  printf("Sample age us: avg %.1f max %lu\n", (double)sumAgeUs / validSamples, (unsigned long)maxAgeUs);
+  if (!replayFile)
+  {
+    printf("Timestamp error arcsec: avg %.2f max %lu\n",
+           (double)angleRawToArcSeconds((uint32_t)(sumErrorRaw / validSamples)), (unsigned long)angleRawToArcSeconds(maxErrorRaw));
+  }
+  if (timerUs > 0)
+  {
+    printf("Timer: ticks %lu, max tick us %lu, frames %lu, dropped samples %lu\n", (unsigned long)sampler.getTickCount(),
+           (unsigned long)maxCallUs, (unsigned long)iterations, (unsigned long)sampler.getDroppedCount());
+    if (triggerUs > 0)
+    {
+      TriggerScheduler& scheduler = sampler.getTriggerScheduler();
+      printf("Trigger: pulses %lu, skipped %lu, latches %lu, phase error us %ld, max lateness us %lu\n",
+             (unsigned long)scheduler.getPulseCount(), (unsigned long)scheduler.getSkippedCount(),
+             (unsigned long)simulator.getLatchCount(), (long)scheduler.getPhaseErrorUs(),
+             (unsigned long)scheduler.getMaxLatenessUs());
+    }
+  }
+  else
+  {
+    printf("getRawAngle: max call us %lu, stale %lu\n", (unsigned long)maxCallUs, (unsigned long)staleCalls);
+  }
+  printf("Transactions: %lu, errors: %lu\n", (unsigned long)encoder.getTransactionCount(), (unsigned long)encoder.getErrorCount());
+  bool configurationLost = false;
+  if (!replayFile && (negotiate || outageLengthMs > 0))
+  {
+    configurationLost = (serialHandler.getBaudrate() != negotiatedBaudrate) || (triggerUs > 0 && !simulator.isTriggerMode());
+    printf("Link: %lu bit/s (negotiated %lu), restores %lu, encoder trigger mode %d\n",
+           serialHandler.getBaudrate(), negotiatedBaudrate, (unsigned long)restoreCount, simulator.isTriggerMode());
+  }
+  if (replayFile)
+  {
+    struct timespec wallEnd;
+    clock_gettime(CLOCK_MONOTONIC, &wallEnd);
+    double wallMs = (wallEnd.tv_sec - wallStart.tv_sec) * 1e3 + (wallEnd.tv_nsec - wallStart.tv_nsec) / 1e6;
+    printf("Replay: TX matched %lu, mismatched %lu, extra %lu, RX delivered %lu, skipped %lu, begin() %lu, finished %d\n",
+           (unsigned long)replay.getMatchedCount(), (unsigned long)replay.getMismatchedCount(),
+           (unsigned long)replay.getExtraTxCount(), (unsigned long)replay.getDeliveredRxCount(),
+           (unsigned long)replay.getSkippedRxCount(), (unsigned long)replay.getConfigCount(), replay.isFinished());
+    printf("Replay wall time: %.1f ms\n", wallMs);
+  }
+  else
+  {
+    printf("Simulator: requests %lu, replies %lu, corrupted %lu, dropped %lu, ignored bytes %lu\n",
+           (unsigned long)simulator.getRequestCount(), (unsigned long)simulator.getReplyCount(),
+           (unsigned long)simulator.getCorruptedReplyCount(), (unsigned long)simulator.getDroppedRequestCount(),
+           (unsigned long)simulator.getIgnoredByteCount());
+  }
+  printf("RX: lost in Serial1 %lu, ring overruns %lu, ring dropped bytes %lu\n", (unsigned long)Serial1.getLostRxCount(),
+         (unsigned long)serialHandler.getRxOverrunCount(), (unsigned long)serialHandler.getRxDroppedCount());
+  sim_rs485_stats_t rs485 = simGetRs485Stats();
+  printf("RS-485: frames %lu, hold after last stop bit us avg %.1f max %lu, truncated %lu, undriven bytes %lu, lost reply bytes %lu\n",
+         (unsigned long)rs485.frames, rs485.turnarounds ? (double)rs485.totalHoldUs / rs485.turnarounds : 0.0,
+         (unsigned long)rs485.maxHoldUs, (unsigned long)rs485.truncatedFrames, (unsigned long)rs485.undrivenBytes,
+         (unsigned long)rs485.lostRxBytes);
+  if (captureFile)
+  {
+    capture.stop();
+    FILE* file = fopen(captureFile, "wb");
+    if (!file || fwrite(capture.getData(), 1, capture.getLength(), file) != capture.getLength())
+    {
+      printf("FAIL: cannot write %s\n", captureFile);
+      return 2;
+    }
+    fclose(file);
+    printf("Capture: %lu bytes, records %lu, lost %lu\n", (unsigned long)capture.getLength(),
+           (unsigned long)capture.getRecordCount(), (unsigned long)capture.getLostCount());
+  }
+  if (printStats)
+  {
+    Serial.setEnabled(true);
+    encoder.printLinkStats();
+  }
+
+  if (maxErrorArcSec >= 0.0 && angleRawToArcSeconds(maxErrorRaw) > maxErrorArcSec)
+  {
+    printf("FAIL: timestamp error above %.1f arcsec\n", maxErrorArcSec);
+    return 1;
+  }
+  if (rs485.truncatedFrames > 0 || rs485.undrivenBytes > 0 || rs485.lostRxBytes > 0)
+  {
+    printf("FAIL: RS-485 turnaround\n");
+    return 1;
+  }
+  if (configurationLost)
+  {
+    printf("FAIL: encoder not back at the negotiated baud rate or trigger mode\n");
+    return 1;
+  }
+  if (Serial1.getLostRxCount() > 0 && serialHandler.getRxOverrunCount() == 0)
+  {
+    printf("FAIL: bytes lost in Serial1, no overrun counted\n");
+    return 1;
+  }
+  printf("PASS\n");
+  return 0;
+}
@@ -0,0 +1,141 @@
+// ****************************************************************************
+/// \file      encoder_tty.cpp
+///
+/// \brief     Runs the real Encoder / SerialHandler on a Linux serial device
+///
+/// \details   Built with -DENCODER_TERMIOS_PORT: the SerialHandler is bound to
+///            TermiosPort instead of Serial1, the encoder code is unchanged. The
+///            device is a USB RS-485 adapter with an HA40+ or the pty of
+///            ha40sim_pty. Real time. Reads angles and prints the rate, the last
+///            angle and the link counters. Exit code 1 if the encoder does not
+///            come up or no sample is valid.
+///            Build and options: see sim/README.md
+///
+/// \author    Christoph Capiaghi
+///
+/// \version   0.1
+///
+/// \date      20221017
+///
+/// \copyright Licensed under the Apache License, Version 2.0 (the "License");
+/// you may not use this file except in compliance with the License.
+/// You may obtain a copy of the License at
+/// http://www.apache.org/licenses/LICENSE-2.0
+///
+/// \pre
+///
+/// \bug
+///
+/// \warning   Linux only
+///
+/// \todo
+///
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "arduino.h"
+#include "HostPorts.hpp"
+#include "../Encoder.hpp"
+#include "../SerialHandler.hpp"
+#include "../Angle.hpp"
+#include "../config.hpp"
+
+#if !defined(ENCODER_TERMIOS_PORT)
+#error "Build with -DENCODER_TERMIOS_PORT, see sim/README.md"
+#endif
+
+static const uint32_t MAX_RUN_US = 60000000UL;   /// Give up after one minute
+
+static void printUsage()
+{
+  printf("Usage: encoder_tty DEVICE [options]\n"
+         "  --samples N            Samples to take (1000)\n"
+         "  --pipelined            Encoder pipeline mode\n"
+         "  --angles N             Angles per B command (1)\n"
+         "  --stats                Encoder link statistics (printLinkStats) on stderr\n"
+         "  --debug                Debug output of the encoder classes on stderr\n");
+}
+
+int main(int argc, char* argv[])
+{
+  uint32_t numberOfSamples = 1000;
+  bool pipelined = false;
+  uint8_t anglesPerRequest = 1;
+  bool printStats = false;
+  const char* device = 0;
+
+  for (int i = 1; i < argc; i++)
+  {
+    const char* arg = argv[i];
+    bool hasValue = (i + 1 < argc);
+    if      (!strcmp(arg, "--samples") && hasValue)      numberOfSamples = strtoul(argv[++i], 0, 0);
+    else if (!strcmp(arg, "--pipelined"))                pipelined = true;
+    else if (!strcmp(arg, "--angles") && hasValue)       anglesPerRequest = (uint8_t)strtoul(argv[++i], 0, 0);
+    else if (!strcmp(arg, "--stats"))                    printStats = true;
+    else if (!strcmp(arg, "--debug"))                    Serial.setEnabled(true);
+    else if (arg[0] != '-' && !device)                   device = arg;
+    else
+    {
+      printUsage();
+      return 2;
+    }
+  }
+  if (!device)
+  {
+    printUsage();
+    return 2;
+  }
+
+  simSetRealTime(true);
+  if (!TermiosPort::open(device))
+  {
+    printf("FAIL: cannot open %s\n", device);
+    return 2;
+  }
+  SerialHandler serialHandler;
+  Encoder encoder;
+  serialHandler.initialize();
+
+  uint32_t startUs = micros();
+  uint8_t initErrorCode = encoder.initialize(&serialHandler);
+  if (encoder.isDegraded())
+  {
+    printf("FAIL: encoder init\n");
+    return 1;
+  }
+  printf("Init: %lu us, %lu bit/s, first sample: %u\n", (unsigned long)(micros() - startUs), serialHandler.getBaudrate(), initErrorCode);
+
+  encoder.setAnglesPerRequest(anglesPerRequest);
+  encoder.setPipelineMode(pipelined);
+
+  uint32_t lastSampleCount = encoder.getSampleCount();
+  uint32_t validSamples = 0;
+  uint32_t staleCalls = 0;
+  encoder_sample_t sample;
+  startUs = micros();
+  while (validSamples < numberOfSamples && (micros() - startUs) < MAX_RUN_US)
+  {
+    uint32_t rawAngle;
+    if (encoder.getRawAngle(rawAngle) == RC_STALE) staleCalls++;
+    if (encoder.getSampleCount() == lastSampleCount) continue;
+    lastSampleCount = encoder.getSampleCount();
+    if (encoder.getSample(sample) == RC_OK) validSamples++;
+  }
+
+  uint32_t elapsedUs = micros() - startUs;
+  printf("Samples: %lu in %lu us (%.1f samples/s), stale calls: %lu\n",
+         (unsigned long)validSamples, (unsigned long)elapsedUs,
+         elapsedUs ? validSamples * 1e6 / elapsedUs : 0.0, (unsigned long)staleCalls);
+  if (validSamples > 0) printf("Last angle: %.4f deg\n", angleRawToDeg(sample.rawAngle));
+  printf("Encoder: transactions %lu, errors %lu, RX ring overruns %lu, dropped bytes %lu\n",
+         (unsigned long)encoder.getTransactionCount(), (unsigned long)encoder.getErrorCount(),
+         (unsigned long)serialHandler.getRxOverrunCount(), (unsigned long)serialHandler.getRxDroppedCount());
+  if (printStats)
+  {
+    Serial.setEnabled(true);
+    encoder.printLinkStats();
+  }
+  TermiosPort::close();
+  return (validSamples > 0) ? 0 : 1;
+}
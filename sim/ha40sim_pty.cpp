@@ -0,0 +1,170 @@
+// ****************************************************************************
+/// \file      ha40sim_pty.cpp
+///
+/// \brief     HA40+ simulator on a pseudo-terminal
+///
+/// \details   Opens a pty and prints the slave device name. Any program that talks
+///            to a serial port (host tools, a USB-serial bridge test setup) can use
+///            it like the RS-485 adapter of a real encoder. Parity and baud rate
+///            are taken from the termios settings of the slave side when a byte is
+///            read. Real time, the reply latency is kept with a 100 us resolution.
+///            Options: see sim/README.md
+///
+/// \author    Christoph Capiaghi
+///
+/// \version   0.1
+///
+/// \date      20221017
+///
+/// \copyright Licensed under the Apache License, Version 2.0 (the "License");
+/// you may not use this file except in compliance with the License.
+/// You may obtain a copy of the License at
+/// http://www.apache.org/licenses/LICENSE-2.0
+///
+/// \pre
+///
+/// \bug       A client that switches the parity back right after write() can race
+///            the termios read of the parity trick: use --warm in that case.
+///
+/// \warning   Linux only
+///
+/// \todo
+///
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include "HA40Simulator.hpp"
+
+static volatile sig_atomic_t s_running = 1;
+
+static void stop(int)
+{
+  s_running = 0;
+}
+
+static uint32_t nowUs()
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint32_t)(now.tv_sec * 1000000ULL + now.tv_nsec / 1000);
+}
+
+static unsigned long toBaudrate(const speed_t speed)
+{
+  switch (speed)
+  {
+    case B9600:    return 9600;
+    case B19200:   return 19200;
+    case B38400:   return 38400;
+    case B57600:   return 57600;
+    case B115200:  return 115200;
+    case B230400:  return 230400;
+    case B460800:  return 460800;
+    case B921600:  return 921600;
+    default:       return 0;
+  }
+}
+
+int main(int argc, char* argv[])
+{
+  ha40sim_config_t config = HA40Simulator::getDefaultConfig();
+  config.powerUpUs = 0;
+  const char* linkName = 0;
+
+  for (int i = 1; i < argc; i++)
+  {
+    const char* arg = argv[i];
+    bool hasValue = (i + 1 < argc);
+    if      (!strcmp(arg, "--address") && hasValue)    config.slaveAddress = (uint8_t)strtoul(argv[++i], 0, 0);
+    else if (!strcmp(arg, "--latency-us") && hasValue) config.replyLatencyUs = strtoul(argv[++i], 0, 0);
+    else if (!strcmp(arg, "--jitter-us") && hasValue)  config.latencyJitterUs = strtoul(argv[++i], 0, 0);
+    else if (!strcmp(arg, "--velocity") && hasValue)   config.velocityDegPerS = atof(argv[++i]);
+    else if (!strcmp(arg, "--noise") && hasValue)      config.noiseCounts = atof(argv[++i]);
+    else if (!strcmp(arg, "--ber") && hasValue)        config.byteErrorRate = atof(argv[++i]);
+    else if (!strcmp(arg, "--drop") && hasValue)       config.dropRate = atof(argv[++i]);
+    else if (!strcmp(arg, "--warm"))                   config.startInEightBitMode = true;
+    else if (!strcmp(arg, "--link") && hasValue)       linkName = argv[++i];
+    else
+    {
+      printf("Usage: ha40sim_pty [--address N] [--latency-us US] [--jitter-us US] [--velocity DEG_S]\n"
+             "                   [--noise COUNTS] [--ber P] [--drop P] [--warm] [--link PATH]\n");
+      return 2;
+    }
+  }
+
+  int master = posix_openpt(O_RDWR | O_NOCTTY);
+  if (master < 0 || grantpt(master) != 0 || unlockpt(master) != 0)
+  {
+    perror("pty");
+    return 1;
+  }
+  const char* slaveName = ptsname(master);
+
+  // Keep the slave open: no hangup between two client sessions, termios stay readable
+  int slave = open(slaveName, O_RDWR | O_NOCTTY);
+  struct termios settings;
+  tcgetattr(slave, &settings);
+  cfmakeraw(&settings);
+  cfsetspeed(&settings, B230400);
+  tcsetattr(slave, TCSANOW, &settings);
+
+  if (linkName)
+  {
+    unlink(linkName);
+    if (symlink(slaveName, linkName) != 0) perror("symlink");
+  }
+  printf("HA40+ simulator on %s\n", linkName ? linkName : slaveName);
+  fflush(stdout);
+
+  signal(SIGINT, stop);
+  signal(SIGTERM, stop);
+
+  HA40Simulator simulator;
+  config.baudrate = 230400;
+  simulator.initialize(config);
+  uint32_t startUs = nowUs();
+
+  while (s_running)
+  {
+    struct pollfd fd = { master, POLLIN, 0 };
+    int timeoutMs = simulator.isTransmitPending() ? 0 : 10;
+    if (poll(&fd, 1, timeoutMs) > 0 && (fd.revents & POLLIN))
+    {
+      uint8_t buffer[64];
+      ssize_t length = read(master, buffer, sizeof(buffer));
+      tcgetattr(slave, &settings);
+      bool parity   = (settings.c_cflag & PARENB) != 0;
+      bool odd      = (settings.c_cflag & PARODD) != 0;
+      unsigned long baudrate = toBaudrate(cfgetospeed(&settings));
+      for (ssize_t i = 0; i < length; i++)
+      {
+        uint8_t ones = __builtin_popcount(buffer[i]);
+        bool ninthBit = parity && ((odd && (ones % 2) == 0) || (!odd && (ones % 2) == 1));
+        simulator.receive(buffer[i], ninthBit, baudrate, nowUs() - startUs);
+      }
+    }
+
+    uint8_t data;
+    while (simulator.transmit(nowUs() - startUs, data))
+    {
+      if (write(master, &data, 1) != 1) break;
+    }
+    if (simulator.isTransmitPending()) usleep(100);
+  }
+
+  printf("Requests %lu, replies %lu, corrupted %lu, dropped %lu, ignored bytes %lu\n",
+         (unsigned long)simulator.getRequestCount(), (unsigned long)simulator.getReplyCount(),
+         (unsigned long)simulator.getCorruptedReplyCount(), (unsigned long)simulator.getDroppedRequestCount(),
+         (unsigned long)simulator.getIgnoredByteCount());
+  if (linkName) unlink(linkName);
+  close(slave);
+  close(master);
+  return 0;
+}